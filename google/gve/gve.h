@@ -8,6 +8,8 @@
 #define _GVE_H_
 
 #include <linux/dma-mapping.h>
+#include <linux/interrupt.h>
+#include <linux/jump_label.h>
 #include <linux/netdevice.h>
 #include <linux/pci.h>
 #include <linux/u64_stats_sync.h>
@@ -62,7 +64,15 @@
 
 #define GVE_RX_BUFFER_SIZE_DQO 2048
 #define GVE_MIN_RX_BUFFER_SIZE 2048
-#define GVE_MAX_RX_BUFFER_SIZE 4096
+/* RDA buffers larger than a page are backed by compound pages. The DQO rx
+ * completion reports packet_len in 14 bits, so a full 16K buffer cannot be
+ * described.
+ */
+#define GVE_MAX_RX_BUFFER_SIZE 8192
+
+/* Rx buffers posted between doorbell writes, tunable through debugfs */
+#define GVE_DEFAULT_RX_DB_BATCH GVE_RX_BUF_THRESH_DQO
+#define GVE_MAX_RX_DB_BATCH 256
 
 #define GVE_RSS_KEY_SIZE 40
 #define GVE_RSS_INDIR_SIZE 128
@@ -70,6 +80,10 @@
 #define GVE_HEADER_BUFFER_SIZE_MIN 64
 #define GVE_HEADER_BUFFER_SIZE_MAX 256
 #define GVE_HEADER_BUFFER_SIZE_DEFAULT 128
+/* Room left in front of a header buffer for the skb built around it. The
+ * device expects header buffers to be 64-byte aligned.
+ */
+#define GVE_RX_HDR_HEADROOM ALIGN(NET_SKB_PAD, 64)
 
 #define GVE_XDP_ACTIONS 5
 
@@ -81,12 +95,13 @@
 /* Maximum TSO size supported on DQO */
 #define GVE_DQO_TX_MAX	0x3FFFF
 
+/* 2K buffers for DQO-QPL by default */
 #define GVE_TX_BUF_SHIFT_DQO 11
 
-/* 2K buffers for DQO-QPL */
-#define GVE_TX_BUF_SIZE_DQO BIT(GVE_TX_BUF_SHIFT_DQO)
-#define GVE_TX_BUFS_PER_PAGE_DQO (PAGE_SIZE >> GVE_TX_BUF_SHIFT_DQO)
-#define GVE_MAX_TX_BUFS_PER_PKT (DIV_ROUND_UP(GVE_DQO_TX_MAX, GVE_TX_BUF_SIZE_DQO))
+/* Largest DQO-QPL TX buffer: bounded by a single QPL page and by the largest
+ * power of two a TX descriptor can describe.
+ */
+#define GVE_TX_MAX_BUF_SHIFT_DQO min(PAGE_SHIFT, 13)
 
 /* If number of free/recyclable buffers are less than this threshold; driver
  * allocs and uses a non-qpl page on the receive path of DQO QPL to free
@@ -168,29 +183,51 @@ struct gve_rx_compl_queue_dqo {
 	u32 mask; /* Mask for indices to the size of the ring */
 };
 
+/* A page that header-split buffers are carved out of. Buffers are handed
+ * out from it in order and the page is reused once the stack has released
+ * every skb built on one of them.
+ */
+struct gve_header_page {
+	/* page_offset is the offset of the next buffer to hand out. */
+	struct gve_rx_slot_page_info page_info;
+	dma_addr_t addr;
+};
+
 struct gve_header_buf {
-	u8 *data;
+	struct gve_header_page *hdr_page;
+	u8 *data; /* start of the header, past GVE_RX_HDR_HEADROOM */
 	dma_addr_t addr;
 };
 
 /* Stores state for tracking buffers posted to HW */
 struct gve_rx_buf_state_dqo {
+	/* Hot fields, read when posting the buffer and receiving into it. */
+
 	/* The page posted to HW. */
 	struct gve_rx_slot_page_info page_info;
 
 	/* The DMA address corresponding to `page_info`. */
 	dma_addr_t addr;
 
+	/* Pointer to the header buffer when header-split is active */
+	struct gve_header_buf *hdr_buf;
+
+	/* Cold fields, only used when deciding whether to recycle. */
+
 	/* Last offset into the page when it only had a single reference, at
 	 * which point every other offset is free to be reused.
 	 */
 	u32 last_single_ref_offset;
 
-	/* Pointer to the header buffer when header-split is active */
-	struct gve_header_buf *hdr_buf;
+	/* True if the buf_state is owned by HW or the datapath, i.e. it is not
+	 * on any of the free, recycled or used index arrays.
+	 */
+	bool allocated;
 
-	/* Linked list index to next element in the list, or -1 if none */
-	s16 next;
+	/* Allocation order of `page_info.page`, kept so the page is unmapped
+	 * with its own size after the buffer size has been reconfigured.
+	 */
+	u8 page_order;
 };
 
 /* `head` and `tail` are indices into an array, or -1 if empty. */
@@ -199,6 +236,23 @@ struct gve_index_list {
 	s16 tail;
 };
 
+/* Dense array of indices used as a LIFO stack. */
+struct gve_index_stack {
+	u16 *ids;
+	u16 top; /* Number of indices on the stack */
+};
+
+/* Dense array of indices used as a FIFO ring. `head` and `tail` are
+ * free-running and masked on access, so the ring is empty when they are
+ * equal.
+ */
+struct gve_index_ring {
+	u16 *ids;
+	u32 head; /* Next index to dequeue */
+	u32 tail; /* Next slot to enqueue into */
+	u32 mask; /* Ring size is mask + 1, a power of two */
+};
+
 /* A single received packet split across multiple buffers may be
  * reconstructed using the information in this structure.
  */
@@ -211,17 +265,74 @@ struct gve_rx_ctx {
 	bool drop_pkt;
 };
 
+/* Software LRO state for GQI rings, which have no hardware RSC. At most one
+ * TCP aggregate is held and it is always flushed before the poll returns.
+ */
+struct gve_rx_lro {
+	struct sk_buff *skb; /* aggregate being built or NULL if none */
+	u32 next_seq; /* TCP sequence number expected in the next segment */
+	u16 mss; /* payload length of the first segment */
+	u16 hdr_len; /* L2-L4 header length of every segment */
+	u16 segs; /* number of segments merged into skb */
+};
+
+/* Why the driver freed an skb instead of delivering or transmitting it. Each
+ * maps onto the closest core skb_drop_reason for kfree_skb tracing; the
+ * gve_drop tracepoint reports the exact one. Only real allocation failures
+ * map to NOMEM. Bad rx metadata from the device maps to DEV_HDR, a bad jumbo
+ * hop-by-hop header to IPV6BADEXTHDR, and tx packets the device could not be
+ * handed or never completed to DEV_READY.
+ */
+enum gve_drop_reason {
+	GVE_DROP_RX_DESC_ERR, /* device returned a bad or errored descriptor */
+	GVE_DROP_RX_FRAG_SIZE, /* fragment larger than the packet buffer */
+	GVE_DROP_RX_INCOMPLETE, /* packet cut short by a sequence mismatch */
+	GVE_DROP_RX_HSPLIT_ERR, /* header overflowed the header buffer */
+	GVE_DROP_RX_RSC_ERR, /* RSC metadata the stack cannot use */
+	GVE_DROP_RX_NOMEM, /* skb or frag allocation failed */
+	GVE_DROP_TX_MAP_ERR, /* payload could not be mapped or staged */
+	GVE_DROP_TX_LINEARIZE, /* too many frags and linearizing failed */
+	GVE_DROP_TX_JUMBO, /* jumbo hop-by-hop header could not be removed */
+	GVE_DROP_TX_COMPL_TIMEOUT, /* no completion before the miss timeout */
+};
+
+/* Counters accumulated over a single poll and committed to the ring stats
+ * once at the end of it.
+ */
 struct gve_rx_cnts {
 	u32 ok_pkt_bytes;
 	u16 ok_pkt_cnt;
 	u16 total_pkt_cnt;
 	u16 cont_pkt_cnt;
 	u16 desc_err_pkt_cnt;
+	u32 header_bytes;
+	u32 hsplit_pkt_cnt;
+	u32 hsplit_hbo_pkt_cnt;
+	u32 hsplit_err_pkt_cnt;
+	u32 copybreak_pkt_cnt;
+	u32 copied_pkt_cnt;
+	u32 skb_alloc_fail_cnt;
+	u32 frag_flip_cnt;
+	u32 frag_copy_cnt;
+	u32 frag_alloc_cnt;
+	u32 lro_merged_pkt_cnt;
+	u32 lro_aggr_cnt;
+	u32 page_aligned_pkt_cnt;
+	u32 rsc_pkt_cnt;
+	u32 rsc_seg_cnt;
+	u32 xdp_tx_errors;
+	u32 xdp_redirect_errors;
+	u32 xdp_alloc_fails;
+	u32 xdp_actions[GVE_XDP_ACTIONS];
 };
 
 /* Contains datapath state used to represent an RX queue. */
 struct gve_rx_ring {
-	struct gve_priv *gve;
+	/* Cachelines 0-3 -- Accessed & dirtied during rx processing */
+	u32 cnt; /* free-running total number of completed packets */
+	u32 fill_cnt; /* free-running total number of descs and buffs posted */
+	u32 db_fill_cnt; /* fill_cnt last written to the doorbell, GQI only */
+	struct gve_rx_ctx ctx; /* Info for packet currently being processed in this ring. */
 	union {
 		/* GQI fields */
 		struct {
@@ -235,6 +346,8 @@ struct gve_rx_ring {
 			u32 qpl_copy_pool_mask;
 			u32 qpl_copy_pool_head;
 			struct gve_rx_slot_page_info *qpl_copy_pool;
+
+			struct gve_rx_lro lro;
 		};
 
 		/* DQO fields. */
@@ -245,51 +358,67 @@ struct gve_rx_ring {
 			struct gve_rx_buf_state_dqo *buf_states;
 			u16 num_buf_states;
 
-			/* Linked list of gve_rx_buf_state_dqo. Index into
-			 * buf_states, or -1 if empty.
+			/* Stack of free gve_rx_buf_state_dqo. Indexes into
+			 * buf_states.
 			 */
-			s16 free_buf_states;
+			struct gve_index_stack free_buf_states;
 
-			/* Linked list of gve_rx_buf_state_dqo. Indexes into
-			 * buf_states, or -1 if empty.
+			/* FIFO of gve_rx_buf_state_dqo. Indexes into
+			 * buf_states.
 			 *
-			 * This list contains buf_states which are pointing to
+			 * This ring contains buf_states which are pointing to
 			 * valid buffers.
 			 *
 			 * We use a FIFO here in order to increase the
 			 * probability that buffers can be reused by increasing
 			 * the time between usages.
 			 */
-			struct gve_index_list recycled_buf_states;
+			struct gve_index_ring recycled_buf_states;
 
-			/* Linked list of gve_rx_buf_state_dqo. Indexes into
-			 * buf_states, or -1 if empty.
+			/* FIFO of gve_rx_buf_state_dqo. Indexes into
+			 * buf_states.
 			 *
-			 * This list contains buf_states which have buffers
+			 * This ring contains buf_states which have buffers
 			 * which cannot be reused yet.
 			 */
-			struct gve_index_list used_buf_states;
+			struct gve_index_ring used_buf_states;
 
-			/* Array of buffers for header-split */
+			/* Array of buffers for header-split, one per buffer
+			 * state and indexed by buffer id.
+			 */
 			struct gve_header_buf *hdr_bufs;
 
+			/* Pages the header buffers are carved out of */
+			struct gve_header_page *hdr_pages;
+			u16 num_hdr_pages;
+			u16 hdr_page_idx; /* page buffers are handed out from */
+
 			/* qpl assigned to this queue */
 			struct gve_queue_page_list *qpl;
 
 			/* index into queue page list */
 			u32 next_qpl_page_idx;
 
-			/* track number of used buffers */
-			u16 used_buf_states_cnt;
+			/* RDA data buffers come from here when set. The stack
+			 * returns them to the pool instead of the driver
+			 * recycling them.
+			 */
+			struct page_pool *page_pool;
 		} dqo;
 	};
 
-	u64 rbytes; /* free-running bytes received */
+	/* Cacheline 4 -- Read-mostly fields */
+	struct gve_priv *gve ____cacheline_aligned;
+	struct gve_queue_resources *q_resources; /* head and tail pointer idx */
+	struct xsk_buff_pool *xsk_pool;
+	u32 mask; /* masks the cnt and fill_cnt to the size of the ring */
+	u32 q_num; /* queue index */
+	u32 ntfy_id; /* notification block index */
+
+	/* Cachelines 5-8 -- Stats, dirtied once per poll */
+	u64 rbytes ____cacheline_aligned; /* free-running bytes received */
 	u64 rheader_bytes; /* free-running header bytes received */
 	u64 rpackets; /* free-running packets received */
-	u32 cnt; /* free-running total number of completed packets */
-	u32 fill_cnt; /* free-running total number of descs and buffs posted */
-	u32 mask; /* masks the cnt and fill_cnt to the size of the ring */
 	u64 rx_hsplit_pkt; /* free-running packets with headers split */
 	u64 rx_hsplit_hbo_pkt; /* free-running packets with header buffer overflow */
 	u64 rx_copybreak_pkt; /* free-running count of copybreak packets */
@@ -303,24 +432,28 @@ struct gve_rx_ring {
 	u64 rx_frag_flip_cnt; /* free-running count of rx segments where page_flip was used */
 	u64 rx_frag_copy_cnt; /* free-running count of rx segments copied */
 	u64 rx_frag_alloc_cnt; /* free-running count of rx page allocations */
+	u64 rx_lro_merged_pkt; /* free-running count of segments merged by software LRO */
+	u64 rx_lro_aggr_cnt; /* free-running count of multi-segment software LRO packets */
+	/* free-running count of header-split packets with page-aligned payload */
+	u64 rx_page_aligned_pkt;
+	u64 rx_rsc_pkt; /* free-running count of hardware RSC packets */
+	u64 rx_rsc_segs; /* free-running count of segments coalesced by RSC */
+	u64 doorbell_cnt; /* free-running count of doorbell writes */
+	u64 doorbell_skipped; /* free-running count of doorbell writes elided */
 	u64 xdp_tx_errors;
 	u64 xdp_redirect_errors;
 	u64 xdp_alloc_fails;
 	u64 xdp_actions[GVE_XDP_ACTIONS];
-	u32 q_num; /* queue index */
-	u32 ntfy_id; /* notification block index */
-	struct gve_queue_resources *q_resources; /* head and tail pointer idx */
-	dma_addr_t q_resources_bus; /* dma address for the queue resources */
 	struct u64_stats_sync statss; /* sync stats for 32bit archs */
 
-	struct gve_rx_ctx ctx; /* Info for packet currently being processed in this ring. */
+	/* Slow-path fields */
+	dma_addr_t q_resources_bus ____cacheline_aligned; /* dma address for the queue resources */
+	struct page_frag_cache page_cache; /* Page cache to allocate XDP frames */
 
 	/* XDP stuff */
 	struct xdp_rxq_info xdp_rxq;
 	struct xdp_rxq_info xsk_rxq;
-	struct xsk_buff_pool *xsk_pool;
-	struct page_frag_cache page_cache; /* Page cache to allocate XDP frames */
-};
+} ____cacheline_aligned;
 
 /* A TX desc ring entry */
 union gve_tx_desc {
@@ -388,23 +521,26 @@ enum gve_packet_state {
 	GVE_PACKET_STATE_TIMED_OUT_COMPL,
 };
 
+/* DMA mapping of a single TX buffer on RDA queues */
+struct gve_tx_dma_buf_dqo {
+	DEFINE_DMA_UNMAP_ADDR(dma);
+	DEFINE_DMA_UNMAP_LEN(len);
+};
+
 struct gve_tx_pending_packet_dqo {
 	struct sk_buff *skb; /* skb for this packet */
 
-	/* 0th element corresponds to the linear portion of `skb`, should be
-	 * unmapped with `dma_unmap_single`.
+	/* Index of the first of the packet's `num_bufs` TX buffers. The rest
+	 * are chained through `tx_buf_next`.
 	 *
-	 * All others correspond to `skb`'s frags and should be unmapped with
+	 * For RDA, the first buffer corresponds to the linear portion of
+	 * `skb` and should be unmapped with `dma_unmap_single`. All others
+	 * correspond to `skb`'s frags and should be unmapped with
 	 * `dma_unmap_page`.
+	 *
+	 * For QPL, these are the bounce buffers `skb` was copied into.
 	 */
-	union {
-		struct {
-			DEFINE_DMA_UNMAP_ADDR(dma[MAX_SKB_FRAGS + 1]);
-			DEFINE_DMA_UNMAP_LEN(len[MAX_SKB_FRAGS + 1]);
-		};
-		s16 tx_qpl_buf_ids[GVE_MAX_TX_BUFS_PER_PKT];
-	};
-
+	s16 tx_buf_head;
 	u16 num_bufs;
 
 	/* Linked list index to next element in the list, or -1 if none */
@@ -428,6 +564,16 @@ struct gve_tx_pending_packet_dqo {
 	unsigned long timeout_jiffies;
 };
 
+/* Buckets of the tx latency histograms. Bucket n counts latencies in
+ * [2^(n-1), 2^n) nanoseconds and the last one everything above.
+ */
+#define GVE_TX_LAT_BUCKETS 32
+
+struct gve_tx_lat_hist {
+	u64 compl[GVE_TX_LAT_BUCKETS]; /* doorbell to completion, sampled */
+	u64 reinject[GVE_TX_LAT_BUCKETS]; /* DQO miss to re-injection */
+};
+
 /* Contains datapath state used to represent a TX queue. */
 struct gve_tx_ring {
 	/* Cacheline 0 -- Accessed & dirtied during transmit */
@@ -460,33 +606,40 @@ struct gve_tx_ring {
 			 */
 			u32 last_re_idx;
 
+			/* Completion tag of the last packet posted */
+			s16 last_compl_tag;
+
 			/* free running number of packet buf descriptors posted */
 			u16 posted_packet_desc_cnt;
 			/* free running number of packet buf descriptors completed */
 			u16 completed_packet_desc_cnt;
 
-			/* QPL fields */
+			/* TX buffer fields */
 			struct {
-			       /* Linked list of gve_tx_buf_dqo. Index into
-				* tx_qpl_buf_next, or -1 if empty.
+			       /* Linked list of TX buffers. Index into
+				* tx_buf_next, or -1 if empty.
 				*
 				* This is a consumer list owned by the TX path. When it
 				* runs out, the producer list is stolen from the
 				* completion handling path
-				* (dqo_compl.free_tx_qpl_buf_head).
+				* (dqo_compl.free_tx_buf_head).
 				*/
-				s16 free_tx_qpl_buf_head;
+				s16 free_tx_buf_head;
 
-			       /* Free running count of the number of QPL tx buffers
+			       /* Free running count of the number of tx buffers
 				* allocated
 				*/
-				u32 alloc_tx_qpl_buf_cnt;
+				u32 alloc_tx_buf_cnt;
 
-				/* Cached value of `dqo_compl.free_tx_qpl_buf_cnt` */
-				u32 free_tx_qpl_buf_cnt;
+				/* Cached value of `dqo_compl.free_tx_buf_cnt` */
+				u32 free_tx_buf_cnt;
 			};
 		} dqo_tx;
 	};
+	u32 db_val; /* tail last written to the doorbell */
+	/* Written next to db_val, but read under statss */
+	u64 doorbell_cnt; /* free-running count of doorbell writes */
+	u64 doorbell_skipped; /* free-running count of doorbell writes elided */
 
 	/* Cacheline 1 -- Accessed & dirtied during gve_clean_tx_done */
 	union {
@@ -533,22 +686,22 @@ struct gve_tx_ring {
 			 */
 			struct gve_index_list timed_out_completions;
 
-			/* QPL fields */
+			/* TX buffer fields */
 			struct {
-				/* Linked list of gve_tx_buf_dqo. Index into
-				 * tx_qpl_buf_next, or -1 if empty.
+				/* Linked list of TX buffers. Index into
+				 * tx_buf_next, or -1 if empty.
 				 *
 				 * This is the producer list, owned by the completion
 				 * handling path. When the consumer list
-				 * (dqo_tx.free_tx_qpl_buf_head) is runs out, this list
+				 * (dqo_tx.free_tx_buf_head) is runs out, this list
 				 * will be stolen.
 				 */
-				atomic_t free_tx_qpl_buf_head;
+				atomic_t free_tx_buf_head;
 
 				/* Free running count of the number of tx buffers
 				 * freed
 				 */
-				atomic_t free_tx_qpl_buf_cnt;
+				atomic_t free_tx_buf_cnt;
 			};
 		} dqo_compl;
 	} ____cacheline_aligned;
@@ -577,19 +730,28 @@ struct gve_tx_ring {
 
 			u32 complq_mask; /* complq size is complq_mask + 1 */
 
-			/* QPL fields */
+			/* TX buffer fields */
 			struct {
 				/* qpl assigned to this queue */
 				struct gve_queue_page_list *qpl;
 
-				/* Each QPL page is divided into TX bounce buffers
-				 * of size GVE_TX_BUF_SIZE_DQO. tx_qpl_buf_next is
-				 * an array to manage linked lists of TX buffers.
+				/* DMA mappings of the TX buffers, RDA only */
+				struct gve_tx_dma_buf_dqo *tx_dma_bufs;
+
+				/* For QPL, each QPL page is divided into TX
+				 * bounce buffers of size BIT(tx_buf_shift). For
+				 * RDA, each TX buffer is a mapped slot in
+				 * tx_dma_bufs. tx_buf_next is an array to manage
+				 * linked lists of TX buffers.
 				 * An entry j at index i implies that j'th buffer
 				 * is next on the list after i
 				 */
-				s16 *tx_qpl_buf_next;
-				u32 num_tx_qpl_bufs;
+				s16 *tx_buf_next;
+				u32 num_tx_bufs;
+				/* QPL only. Follows the device-wide
+				 * enable-max-tx-buffer-size flag.
+				 */
+				u8 tx_buf_shift;
 			};
 		} dqo;
 	} ____cacheline_aligned;
@@ -616,8 +778,27 @@ struct gve_tx_ring {
 	u64 xdp_xsk_sent;
 	u64 xdp_xmit;
 	u64 xdp_xmit_errors;
+
+	/* Latency sampling, one packet in flight at a time */
+	u64 lat_start_ns; /* doorbell time of the sampled packet, 0 if none */
+	u32 lat_id; /* GQI: req at the doorbell, DQO: completion tag */
+	struct gve_tx_lat_hist lat_hist;
 } ____cacheline_aligned;
 
+/* Buckets of the per-poll histograms. Bucket 0 counts zero samples, bucket n
+ * counts samples in [2^(n-1), 2^n) and the last one everything above.
+ */
+#define GVE_NAPI_HIST_BUCKETS 16
+
+struct gve_napi_hist {
+	u64 polls; /* polls sampled */
+	u64 budget_exhausted; /* polls that used up their budget */
+	u64 work[GVE_NAPI_HIST_BUCKETS]; /* rx packets processed per poll */
+	u64 rx_fill[GVE_NAPI_HIST_BUCKETS]; /* rx buffers posted to the NIC */
+	u64 tx_inflight[GVE_NAPI_HIST_BUCKETS]; /* tx descs not yet completed */
+	u64 compl_backlog[GVE_NAPI_HIST_BUCKETS]; /* completions left behind */
+};
+
 /* Wraps the info for one irq including the napi struct and the queues
  * associated with that irq.
  */
@@ -628,6 +809,25 @@ struct gve_notify_block {
 	struct gve_priv *priv;
 	struct gve_tx_ring *tx; /* tx rings on this block */
 	struct gve_rx_ring *rx; /* rx rings on this block */
+	/* Moves the threaded NAPI kthread along with the irq */
+	struct irq_affinity_notify affinity_notify;
+	struct task_struct *pinned_thread; /* napi.thread as last pinned */
+	/* The irq counters have no single writer to put a u64_stats_sync
+	 * under: the irq handler, napi and, for irq_doorbell_cnt, the
+	 * coalescing and tx timeout paths all bump them. As longs accessed
+	 * with READ_ONCE/WRITE_ONCE they do not tear, but racing increments
+	 * may be lost.
+	 */
+	/* count of polls that left the irq masked instead of re-arming it */
+	unsigned long irq_rearm_avoided;
+	bool irq_masked; /* GQI only, last irq doorbell write masked the irq */
+	/* irq doorbell writes outside the irq handler */
+	unsigned long irq_doorbell_cnt;
+	unsigned long irq_mask_cnt; /* mask writes from the irq handler */
+	/* mask writes elided, the irq was already masked */
+	unsigned long irq_mask_skipped;
+	/* per-poll histograms, only updated while enabled in debugfs */
+	struct gve_napi_hist hist;
 };
 
 /* Tracks allowed and current queue settings */
@@ -730,6 +930,7 @@ struct gve_priv {
 	u64 num_registered_pages; /* num pages registered with NIC */
 	struct bpf_prog *xdp_prog; /* XDP BPF program */
 	u32 rx_copybreak; /* copy packets smaller than this */
+	u32 rx_db_batch; /* rx buffers to post between doorbells, power of 2 */
 	u16 default_num_queues; /* default num queues to set up */
 	bool modify_ringsize_enabled;
 
@@ -821,7 +1022,10 @@ struct gve_priv {
 	 */
 	u16 header_buf_size;
 	u8 header_split_strict;
-	struct dma_pool *header_buf_pool;
+	/* Stride of header buffers in their pages, including headroom and
+	 * skb_shared_info. Zero if header buffers are not allocated.
+	 */
+	u16 header_buf_truesize;
 
 	/* The maximum number of rules for flow-steering.
 	 * A non-zero value enables flow-steering.
@@ -833,6 +1037,10 @@ struct gve_priv {
 
 	/* RSS configuration */
 	struct gve_rss_config rss_config;
+
+	struct dentry *debugfs_dir;
+	bool napi_hist_enabled; /* holds a reference on gve_napi_hist_key */
+	bool tx_lat_enabled; /* holds a reference on gve_tx_lat_key */
 };
 
 enum gve_service_task_flags_bit {
@@ -840,6 +1048,7 @@ enum gve_service_task_flags_bit {
 	GVE_PRIV_FLAGS_RESET_IN_PROGRESS	= 2,
 	GVE_PRIV_FLAGS_PROBE_IN_PROGRESS	= 3,
 	GVE_PRIV_FLAGS_DO_REPORT_STATS = 4,
+	GVE_PRIV_FLAGS_DO_PIN_NAPI_THREADS = 5,
 };
 
 enum gve_state_flags_bit {
@@ -854,13 +1063,17 @@ enum gve_ethtool_flags_bit {
 	GVE_PRIV_FLAGS_ENABLE_HEADER_SPLIT	= 1,
 	GVE_PRIV_FLAGS_ENABLE_STRICT_HEADER_SPLIT = 2,
 	GVE_PRIV_FLAGS_ENABLE_MAX_RX_BUFFER_SIZE = 3,
+	GVE_PRIV_FLAGS_ENABLE_RX_ZEROCOPY	= 4,
+	GVE_PRIV_FLAGS_ENABLE_MAX_TX_BUFFER_SIZE = 5,
 };
 
 #define GVE_PRIV_FLAGS_MASK \
 	(BIT(GVE_PRIV_FLAGS_REPORT_STATS)		| \
 	 BIT(GVE_PRIV_FLAGS_ENABLE_HEADER_SPLIT)	| \
 	 BIT(GVE_PRIV_FLAGS_ENABLE_STRICT_HEADER_SPLIT)		| \
-	 BIT(GVE_PRIV_FLAGS_ENABLE_MAX_RX_BUFFER_SIZE))
+	 BIT(GVE_PRIV_FLAGS_ENABLE_MAX_RX_BUFFER_SIZE)	| \
+	 BIT(GVE_PRIV_FLAGS_ENABLE_RX_ZEROCOPY)	| \
+	 BIT(GVE_PRIV_FLAGS_ENABLE_MAX_TX_BUFFER_SIZE))
 
 static inline bool gve_get_do_reset(struct gve_priv *priv)
 {
@@ -925,6 +1138,23 @@ static inline void gve_clear_do_report_stats(struct gve_priv *priv)
 	clear_bit(GVE_PRIV_FLAGS_DO_REPORT_STATS, &priv->service_task_flags);
 }
 
+static inline bool gve_get_do_pin_napi_threads(struct gve_priv *priv)
+{
+	return test_bit(GVE_PRIV_FLAGS_DO_PIN_NAPI_THREADS,
+			&priv->service_task_flags);
+}
+
+static inline void gve_set_do_pin_napi_threads(struct gve_priv *priv)
+{
+	set_bit(GVE_PRIV_FLAGS_DO_PIN_NAPI_THREADS, &priv->service_task_flags);
+}
+
+static inline void gve_clear_do_pin_napi_threads(struct gve_priv *priv)
+{
+	clear_bit(GVE_PRIV_FLAGS_DO_PIN_NAPI_THREADS,
+		  &priv->service_task_flags);
+}
+
 static inline bool gve_get_admin_queue_ok(struct gve_priv *priv)
 {
 	return test_bit(GVE_PRIV_FLAGS_ADMIN_QUEUE_OK, &priv->state_flags);
@@ -1005,6 +1235,11 @@ static inline bool gve_get_enable_max_rx_buffer_size(struct gve_priv *priv)
 	return test_bit(GVE_PRIV_FLAGS_ENABLE_MAX_RX_BUFFER_SIZE, &priv->ethtool_flags);
 }
 
+static inline bool gve_get_enable_max_tx_buffer_size(struct gve_priv *priv)
+{
+	return test_bit(GVE_PRIV_FLAGS_ENABLE_MAX_TX_BUFFER_SIZE, &priv->ethtool_flags);
+}
+
 /* Returns the address of the ntfy_blocks irq doorbell
  */
 static inline __be32 __iomem *gve_irq_doorbell(struct gve_priv *priv,
@@ -1142,6 +1377,14 @@ static inline u32 gve_num_tx_queues(struct gve_priv *priv)
 	return priv->tx_cfg.num_queues + priv->num_xdp_queues;
 }
 
+/* Number of rx buffers to post before writing the doorbell. Capped at half of
+ * the ring so that the NIC is never left short of buffers.
+ */
+static inline u32 gve_rx_db_batch(const struct gve_priv *priv, u32 ring_size)
+{
+	return min_t(u32, READ_ONCE(priv->rx_db_batch), ring_size / 2);
+}
+
 static inline u32 gve_xdp_tx_queue_id(struct gve_priv *priv, u32 queue_id)
 {
 	return priv->tx_cfg.num_queues + queue_id;
@@ -1153,9 +1396,15 @@ static inline u32 gve_xdp_tx_start_queue_id(struct gve_priv *priv)
 }
 
 /* buffers */
+int gve_alloc_pages(struct gve_priv *priv, struct device *dev,
+		    struct page **page, dma_addr_t *dma,
+		    enum dma_data_direction, gfp_t gfp_flags,
+		    unsigned int order);
 int gve_alloc_page(struct gve_priv *priv, struct device *dev,
 		   struct page **page, dma_addr_t *dma,
 		   enum dma_data_direction, gfp_t gfp_flags);
+void gve_free_pages(struct device *dev, struct page *page, dma_addr_t dma,
+		    enum dma_data_direction, unsigned int order);
 void gve_free_page(struct device *dev, struct page *page, dma_addr_t dma,
 		   enum dma_data_direction);
 /* tx handling */
@@ -1179,6 +1428,7 @@ bool gve_rx_work_pending(struct gve_rx_ring *rx);
 int gve_rx_alloc_rings(struct gve_priv *priv);
 void gve_rx_free_rings_gqi(struct gve_priv *priv);
 int gve_recreate_rx_rings(struct gve_priv *priv);
+int gve_reconfigure_tx_buf_size(struct gve_priv *priv, bool enable_max);
 int gve_reconfigure_rx_rings(struct gve_priv *priv,
                              bool enable_hdr_split,
                              int packet_buffer_size);
@@ -1201,9 +1451,30 @@ void gve_rss_config_release(struct gve_rss_config *rss_config);
 int gve_adjust_ring_sizes(struct gve_priv *priv,
 			  int new_tx_desc_cnt,
 			  int new_rx_desc_cnt);
+/* debugfs support */
+DECLARE_STATIC_KEY_FALSE(gve_napi_hist_key);
+void gve_napi_hist_update(struct gve_notify_block *block, int work_done,
+			  bool budget_exhausted);
+DECLARE_STATIC_KEY_FALSE(gve_tx_lat_key);
+void gve_tx_lat_start(const struct gve_priv *priv, struct gve_tx_ring *tx,
+		      u32 id);
+void gve_tx_lat_complete(const struct gve_priv *priv, struct gve_tx_ring *tx,
+			 u32 id);
+void gve_tx_lat_drop(struct gve_tx_ring *tx, u32 id);
+void gve_tx_lat_reinject(const struct gve_priv *priv, struct gve_tx_ring *tx,
+			 unsigned long delay_jiffies);
+void gve_debugfs_create_root(void);
+void gve_debugfs_destroy_root(void);
+void gve_debugfs_init(struct gve_priv *priv);
+void gve_debugfs_exit(struct gve_priv *priv);
+
 /* exported by ethtool.c */
 extern const struct ethtool_ops gve_ethtool_ops;
 extern char gve_driver_name[];
 /* needed by ethtool */
 extern const char gve_version_str[];
+
+/* Layout checks need the complete struct definitions above. */
+#define GVE_SIZE_ASSERT_LAYOUT
+#include "gve_size_assert.h"
 #endif /* _GVE_H_ */
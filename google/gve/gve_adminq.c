@@ -9,6 +9,7 @@
 #include "gve.h"
 #include "gve_adminq.h"
 #include "gve_register.h"
+#include "gve_trace.h"
 
 #define GVE_MAX_ADMINQ_RELEASE_CHECK	500
 #define GVE_ADMINQ_SLEEP_LEN		20
@@ -383,18 +384,21 @@ static int gve_adminq_parse_err(struct gve_priv *priv, u32 status)
  */
 static int gve_adminq_kick_and_wait(struct gve_priv *priv)
 {
+	u64 kick_ns, latency_ns;
 	u32 tail, head;
 	int i;
 
 	tail = ioread32be(&priv->reg_bar0->adminq_event_counter);
 	head = priv->adminq_prod_cnt;
 
+	kick_ns = ktime_get_ns();
 	gve_adminq_kick_cmd(priv, head);
 	if (!gve_adminq_wait_for_cmd(priv, head)) {
 		dev_err(&priv->pdev->dev, "AQ commands timed out, need to reset AQ\n");
 		priv->adminq_timeouts++;
 		return -ENOTRECOVERABLE;
 	}
+	latency_ns = ktime_get_ns() - kick_ns;
 
 	for (i = tail; i < head; i++) {
 		union gve_adminq_command *cmd;
@@ -402,6 +406,7 @@ static int gve_adminq_kick_and_wait(struct gve_priv *priv)
 
 		cmd = &priv->adminq[i & priv->adminq_mask];
 		status = be32_to_cpu(READ_ONCE(cmd->status));
+		trace_gve_adminq_cmd_complete(priv, cmd, status, latency_ns);
 		err = gve_adminq_parse_err(priv, status);
 		if (err)
 			// Return the first error if we failed.
@@ -447,9 +452,8 @@ static int gve_adminq_issue_cmd(struct gve_priv *priv,
 	priv->adminq_prod_cnt++;
 
 	memcpy(cmd, cmd_orig, sizeof(*cmd_orig));
-	opcode = be32_to_cpu(READ_ONCE(cmd->opcode));
-	if (opcode == GVE_ADMINQ_EXTENDED_COMMAND)
-		opcode = be32_to_cpu(cmd->extended_command.inner_opcode);
+	opcode = gve_adminq_cmd_opcode(cmd);
+	trace_gve_adminq_cmd_issue(priv, cmd);
 
 	switch (opcode) {
 	case GVE_ADMINQ_DESCRIBE_DEVICE:
@@ -704,7 +708,7 @@ static int gve_adminq_create_rx_queue(struct gve_priv *priv, u32 queue_index)
 		cmd.create_rx_queue.rx_buff_ring_size =
 			cpu_to_be16(priv->rx_desc_cnt);
 		cmd.create_rx_queue.enable_rsc =
-			!!(priv->dev->features & NETIF_F_LRO);
+			!!(priv->dev->features & NETIF_F_GRO_HW);
 		if (rx->dqo.hdr_bufs)
 			cmd.create_rx_queue.header_buffer_size =
 				cpu_to_be16(priv->header_buf_size);
@@ -985,10 +989,15 @@ int gve_adminq_describe_device(struct gve_priv *priv)
 			 "Driver is running with GQI QPL queue format.\n");
 	}
 	if (gve_is_gqi(priv)) {
+		/* GQI has no RSC, LRO is done in software */
+		priv->dev->hw_features |= NETIF_F_LRO;
 		err = gve_set_desc_cnt(priv, descriptor);
 	} else {
-		/* DQO supports LRO and flow-steering */
-		priv->dev->hw_features |= NETIF_F_LRO;
+		/* DQO supports hardware RSC and flow-steering. RSC keeps
+		 * the segment boundaries, so it is exposed as GRO_HW rather
+		 * than LRO and stays on when forwarding.
+		 */
+		priv->dev->hw_features |= NETIF_F_GRO_HW;
 		priv->dev->hw_features |= NETIF_F_NTUPLE;
 		err = gve_set_desc_cnt_dqo(priv, descriptor, dev_op_dqo_rda);
 	}
@@ -536,6 +536,16 @@ union gve_adminq_command {
 
 static_assert(sizeof(union gve_adminq_command) == 64);
 
+/* Returns the opcode of the command, looking through extended commands */
+static inline u32 gve_adminq_cmd_opcode(const union gve_adminq_command *cmd)
+{
+	u32 opcode = be32_to_cpu(READ_ONCE(cmd->opcode));
+
+	if (opcode == GVE_ADMINQ_EXTENDED_COMMAND)
+		opcode = be32_to_cpu(cmd->extended_command.inner_opcode);
+	return opcode;
+}
+
 int gve_adminq_alloc(struct device *dev, struct gve_priv *priv);
 void gve_adminq_free(struct device *dev, struct gve_priv *priv);
 void gve_adminq_release(struct gve_priv *priv);
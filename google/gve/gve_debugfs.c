@@ -0,0 +1,446 @@
+// SPDX-License-Identifier: (GPL-2.0 OR MIT)
+/* Google virtual Ethernet (gve) driver
+ *
+ * Copyright (C) 2015-2024 Google, Inc.
+ */
+
+#include <linux/debugfs.h>
+#include <linux/log2.h>
+#include <linux/seq_file.h>
+#include "gve.h"
+
+/* Patched into the napi poll loops only while some device has histograms
+ * enabled, so the poll path pays nothing for them otherwise.
+ */
+DEFINE_STATIC_KEY_FALSE(gve_napi_hist_key);
+DEFINE_STATIC_KEY_FALSE(gve_tx_lat_key);
+
+static struct dentry *gve_debugfs_root;
+
+/* Upper bound on the completion descriptors peeked at per sample */
+#define GVE_NAPI_HIST_BACKLOG_SCAN 256
+
+static void gve_napi_hist_add(u64 *hist, u32 val)
+{
+	hist[min_t(u32, fls(val), GVE_NAPI_HIST_BUCKETS - 1)]++;
+}
+
+static u32 gve_tx_compl_backlog_dqo(struct gve_tx_ring *tx)
+{
+	u32 mask = tx->dqo.complq_mask;
+	u32 head = tx->dqo_compl.head;
+	u32 i;
+
+	for (i = 0; i < GVE_NAPI_HIST_BACKLOG_SCAN && i <= mask; i++) {
+		/* The generation flips when the ring wraps */
+		u8 cur_gen = tx->dqo_compl.cur_gen_bit ^ (head + i > mask);
+
+		if (tx->dqo.compl_ring[(head + i) & mask].generation == cur_gen)
+			break;
+	}
+	return i;
+}
+
+static u32 gve_rx_compl_backlog_dqo(struct gve_rx_ring *rx)
+{
+	struct gve_rx_compl_queue_dqo *complq = &rx->dqo.complq;
+	u32 i;
+
+	for (i = 0; i < GVE_NAPI_HIST_BACKLOG_SCAN && i <= complq->mask; i++) {
+		u32 idx = complq->head + i;
+		u8 cur_gen = complq->cur_gen_bit ^ (idx > complq->mask);
+
+		if (complq->desc_ring[idx & complq->mask].generation == cur_gen)
+			break;
+	}
+	return i;
+}
+
+void gve_napi_hist_update(struct gve_notify_block *block, int work_done,
+			  bool budget_exhausted)
+{
+	struct gve_napi_hist *hist = &block->hist;
+	struct gve_priv *priv = block->priv;
+	struct gve_tx_ring *tx = block->tx;
+	struct gve_rx_ring *rx = block->rx;
+
+	if (!READ_ONCE(priv->napi_hist_enabled))
+		return;
+
+	hist->polls++;
+	if (budget_exhausted)
+		hist->budget_exhausted++;
+
+	if (tx) {
+		if (gve_is_gqi(priv)) {
+			gve_napi_hist_add(hist->tx_inflight, tx->req - tx->done);
+			gve_napi_hist_add(hist->compl_backlog,
+					  gve_tx_load_event_counter(priv, tx) -
+					  tx->done);
+		} else {
+			gve_napi_hist_add(hist->tx_inflight,
+					  (tx->dqo_tx.tail - tx->dqo_tx.head) &
+					  tx->mask);
+			gve_napi_hist_add(hist->compl_backlog,
+					  gve_tx_compl_backlog_dqo(tx));
+		}
+	}
+
+	if (rx) {
+		gve_napi_hist_add(hist->work, work_done);
+		if (gve_is_gqi(priv)) {
+			gve_napi_hist_add(hist->rx_fill, rx->fill_cnt - rx->cnt);
+		} else {
+			gve_napi_hist_add(hist->rx_fill,
+					  rx->dqo.complq.mask + 1 -
+					  rx->dqo.complq.num_free_slots);
+			gve_napi_hist_add(hist->compl_backlog,
+					  gve_rx_compl_backlog_dqo(rx));
+		}
+	}
+}
+
+static void gve_tx_lat_add(u64 *hist, u64 ns)
+{
+	hist[min_t(u32, fls64(ns), GVE_TX_LAT_BUCKETS - 1)]++;
+}
+
+/* Called right before a doorbell write. Samples the last packet posted unless
+ * an earlier sample has not completed yet.
+ */
+void gve_tx_lat_start(const struct gve_priv *priv, struct gve_tx_ring *tx,
+		      u32 id)
+{
+	if (!READ_ONCE(priv->tx_lat_enabled) || READ_ONCE(tx->lat_start_ns))
+		return;
+
+	tx->lat_id = id;
+	/* Pairs with the acquire in the completion path */
+	smp_store_release(&tx->lat_start_ns, ktime_get_ns());
+}
+
+/* GQI passes tx->done after cleaning, DQO the tag of a completed packet */
+void gve_tx_lat_complete(const struct gve_priv *priv, struct gve_tx_ring *tx,
+			 u32 id)
+{
+	u64 start = smp_load_acquire(&tx->lat_start_ns);
+
+	if (!start)
+		return;
+	if (gve_is_gqi(priv) ? (s32)(id - tx->lat_id) < 0 : id != tx->lat_id)
+		return;
+
+	gve_tx_lat_add(tx->lat_hist.compl, ktime_get_ns() - start);
+	smp_store_release(&tx->lat_start_ns, 0);
+}
+
+/* The sampled packet was dropped without a completion, DQO only */
+void gve_tx_lat_drop(struct gve_tx_ring *tx, u32 id)
+{
+	if (smp_load_acquire(&tx->lat_start_ns) && id == tx->lat_id)
+		smp_store_release(&tx->lat_start_ns, 0);
+}
+
+/* Every miss completion is tracked, they are rare. The miss time is only
+ * known in jiffies.
+ */
+void gve_tx_lat_reinject(const struct gve_priv *priv, struct gve_tx_ring *tx,
+			 unsigned long delay_jiffies)
+{
+	if (!READ_ONCE(priv->tx_lat_enabled))
+		return;
+
+	gve_tx_lat_add(tx->lat_hist.reinject,
+		       (u64)jiffies_to_usecs(delay_jiffies) * NSEC_PER_USEC);
+}
+
+static void gve_napi_hist_show_one(struct seq_file *s, const char *name,
+				   const u64 *hist)
+{
+	int i;
+
+	seq_printf(s, "  %-14s", name);
+	for (i = 0; i < GVE_NAPI_HIST_BUCKETS; i++)
+		seq_printf(s, " %llu", hist[i]);
+	seq_putc(s, '\n');
+}
+
+static void gve_napi_hist_show_block(struct seq_file *s,
+				     struct gve_notify_block *block,
+				     const char *type, int idx)
+{
+	struct gve_napi_hist *hist = &block->hist;
+
+	seq_printf(s, "%s %d: polls %llu budget_exhausted %llu\n", type, idx,
+		   hist->polls, hist->budget_exhausted);
+	if (block->rx) {
+		gve_napi_hist_show_one(s, "work", hist->work);
+		gve_napi_hist_show_one(s, "rx_fill", hist->rx_fill);
+	}
+	if (block->tx)
+		gve_napi_hist_show_one(s, "tx_inflight", hist->tx_inflight);
+	gve_napi_hist_show_one(s, "compl_backlog", hist->compl_backlog);
+}
+
+static int gve_napi_hist_show(struct seq_file *s, void *unused)
+{
+	struct gve_priv *priv = s->private;
+	struct gve_notify_block *block;
+	int i;
+
+	/* Notify blocks are reallocated on reset, which runs under rtnl */
+	rtnl_lock();
+	seq_printf(s, "enabled %d, bucket n counts [2^(n-1), 2^n)\n",
+		   priv->napi_hist_enabled);
+	if (!priv->ntfy_blocks)
+		goto out;
+
+	for (i = 0; i < gve_num_tx_queues(priv); i++) {
+		block = &priv->ntfy_blocks[gve_tx_idx_to_ntfy(priv, i)];
+		gve_napi_hist_show_block(s, block, "tx", i);
+	}
+	for (i = 0; i < priv->rx_cfg.num_queues; i++) {
+		block = &priv->ntfy_blocks[gve_rx_idx_to_ntfy(priv, i)];
+		gve_napi_hist_show_block(s, block, "rx", i);
+	}
+out:
+	rtnl_unlock();
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(gve_napi_hist);
+
+static void gve_tx_lat_show_one(struct seq_file *s, const char *name,
+				const u64 *hist)
+{
+	int i;
+
+	seq_printf(s, "  %-9s", name);
+	for (i = 0; i < GVE_TX_LAT_BUCKETS; i++)
+		seq_printf(s, " %llu", hist[i]);
+	seq_putc(s, '\n');
+}
+
+static int gve_tx_lat_show(struct seq_file *s, void *unused)
+{
+	struct gve_priv *priv = s->private;
+	struct gve_tx_ring *tx;
+	int i;
+
+	/* Rings are reallocated on reset, which runs under rtnl */
+	rtnl_lock();
+	seq_printf(s, "enabled %d, bucket n counts [2^(n-1), 2^n) ns\n",
+		   priv->tx_lat_enabled);
+	if (!priv->tx)
+		goto out;
+
+	for (i = 0; i < gve_num_tx_queues(priv); i++) {
+		tx = &priv->tx[i];
+		seq_printf(s, "tx %d:\n", i);
+		gve_tx_lat_show_one(s, "compl", tx->lat_hist.compl);
+		if (!gve_is_gqi(priv))
+			gve_tx_lat_show_one(s, "reinject", tx->lat_hist.reinject);
+	}
+out:
+	rtnl_unlock();
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(gve_tx_lat);
+
+static void gve_napi_hist_clear(struct gve_priv *priv)
+{
+	int i;
+
+	if (!priv->ntfy_blocks)
+		return;
+	for (i = 0; i < priv->num_ntfy_blks; i++)
+		memset(&priv->ntfy_blocks[i].hist, 0,
+		       sizeof(priv->ntfy_blocks[i].hist));
+}
+
+static void gve_napi_hist_set_enabled(struct gve_priv *priv, bool enable)
+{
+	if (priv->napi_hist_enabled == enable)
+		return;
+
+	if (enable) {
+		gve_napi_hist_clear(priv);
+		static_branch_inc(&gve_napi_hist_key);
+	} else {
+		static_branch_dec(&gve_napi_hist_key);
+	}
+	WRITE_ONCE(priv->napi_hist_enabled, enable);
+}
+
+static void gve_tx_lat_set_enabled(struct gve_priv *priv, bool enable)
+{
+	int i;
+
+	if (priv->tx_lat_enabled == enable)
+		return;
+
+	if (enable) {
+		for (i = 0; priv->tx && i < gve_num_tx_queues(priv); i++) {
+			memset(&priv->tx[i].lat_hist, 0,
+			       sizeof(priv->tx[i].lat_hist));
+			WRITE_ONCE(priv->tx[i].lat_start_ns, 0);
+		}
+		static_branch_inc(&gve_tx_lat_key);
+	} else {
+		static_branch_dec(&gve_tx_lat_key);
+	}
+	WRITE_ONCE(priv->tx_lat_enabled, enable);
+}
+
+static ssize_t gve_debugfs_read_bool(char __user *buf, size_t count,
+				     loff_t *ppos, bool enabled)
+{
+	char val[3];
+
+	val[0] = enabled ? 'Y' : 'N';
+	val[1] = '\n';
+	val[2] = '\0';
+	return simple_read_from_buffer(buf, count, ppos, val, 2);
+}
+
+static ssize_t gve_napi_hist_enable_read(struct file *file,
+					 char __user *buf, size_t count,
+					 loff_t *ppos)
+{
+	struct gve_priv *priv = file->private_data;
+
+	return gve_debugfs_read_bool(buf, count, ppos,
+				     priv->napi_hist_enabled);
+}
+
+/* Enabling clears the histograms, so every enable starts a fresh sample */
+static ssize_t gve_napi_hist_enable_write(struct file *file,
+					  const char __user *buf,
+					  size_t count, loff_t *ppos)
+{
+	struct gve_priv *priv = file->private_data;
+	bool enable;
+	int err;
+
+	err = kstrtobool_from_user(buf, count, &enable);
+	if (err)
+		return err;
+
+	rtnl_lock();
+	gve_napi_hist_set_enabled(priv, enable);
+	rtnl_unlock();
+	return count;
+}
+
+static const struct file_operations gve_napi_hist_enable_fops = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.read = gve_napi_hist_enable_read,
+	.write = gve_napi_hist_enable_write,
+	.llseek = default_llseek,
+};
+
+static ssize_t gve_tx_lat_enable_read(struct file *file, char __user *buf,
+				      size_t count, loff_t *ppos)
+{
+	struct gve_priv *priv = file->private_data;
+
+	return gve_debugfs_read_bool(buf, count, ppos, priv->tx_lat_enabled);
+}
+
+/* Enabling clears the histograms, so every enable starts a fresh sample */
+static ssize_t gve_tx_lat_enable_write(struct file *file,
+				       const char __user *buf,
+				       size_t count, loff_t *ppos)
+{
+	struct gve_priv *priv = file->private_data;
+	bool enable;
+	int err;
+
+	err = kstrtobool_from_user(buf, count, &enable);
+	if (err)
+		return err;
+
+	rtnl_lock();
+	gve_tx_lat_set_enabled(priv, enable);
+	rtnl_unlock();
+	return count;
+}
+
+static const struct file_operations gve_tx_lat_enable_fops = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.read = gve_tx_lat_enable_read,
+	.write = gve_tx_lat_enable_write,
+	.llseek = default_llseek,
+};
+
+static int gve_rx_db_batch_get(void *data, u64 *val)
+{
+	struct gve_priv *priv = data;
+
+	*val = READ_ONCE(priv->rx_db_batch);
+	return 0;
+}
+
+/* Read once per poll by the rx path, takes effect without a ring reset */
+static int gve_rx_db_batch_set(void *data, u64 val)
+{
+	struct gve_priv *priv = data;
+
+	if (!val || val > GVE_MAX_RX_DB_BATCH || !is_power_of_2(val))
+		return -EINVAL;
+
+	WRITE_ONCE(priv->rx_db_batch, val);
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(gve_rx_db_batch_fops, gve_rx_db_batch_get,
+			gve_rx_db_batch_set, "%llu\n");
+
+void gve_debugfs_init(struct gve_priv *priv)
+{
+	struct dentry *dir;
+
+	if (!gve_debugfs_root)
+		return;
+
+	dir = debugfs_create_dir(pci_name(priv->pdev), gve_debugfs_root);
+	if (IS_ERR_OR_NULL(dir))
+		return;
+
+	debugfs_create_file("napi_hist_enable", 0600, dir, priv,
+			    &gve_napi_hist_enable_fops);
+	debugfs_create_file("napi_histograms", 0400, dir, priv,
+			    &gve_napi_hist_fops);
+	debugfs_create_file("rx_doorbell_batch", 0600, dir, priv,
+			    &gve_rx_db_batch_fops);
+	debugfs_create_file("tx_latency_enable", 0600, dir, priv,
+			    &gve_tx_lat_enable_fops);
+	debugfs_create_file("tx_latency", 0400, dir, priv, &gve_tx_lat_fops);
+	priv->debugfs_dir = dir;
+}
+
+void gve_debugfs_exit(struct gve_priv *priv)
+{
+	debugfs_remove_recursive(priv->debugfs_dir);
+	priv->debugfs_dir = NULL;
+
+	rtnl_lock();
+	gve_napi_hist_set_enabled(priv, false);
+	gve_tx_lat_set_enabled(priv, false);
+	rtnl_unlock();
+}
+
+void gve_debugfs_create_root(void)
+{
+	struct dentry *root;
+
+	root = debugfs_create_dir(gve_driver_name, NULL);
+	if (!IS_ERR_OR_NULL(root))
+		gve_debugfs_root = root;
+}
+
+void gve_debugfs_destroy_root(void)
+{
+	debugfs_remove_recursive(gve_debugfs_root);
+	gve_debugfs_root = NULL;
+}
@@ -8,6 +8,7 @@
 #define _GVE_DQO_H_
 
 #include "gve_adminq.h"
+#include "gve_trace.h"
 
 #define GVE_ITR_ENABLE_BIT_DQO BIT(0)
 #define GVE_ITR_CLEAR_PBA_BIT_DQO BIT(1)
@@ -44,17 +45,33 @@ void gve_rx_reset_rings_dqo(struct gve_priv *priv);
 int gve_clean_tx_done_dqo(struct gve_priv *priv, struct gve_tx_ring *tx,
 			  struct napi_struct *napi);
 void gve_rx_post_buffers_dqo(struct gve_rx_ring *rx);
-void gve_rx_write_doorbell_dqo(const struct gve_priv *priv, int queue_idx);
+void gve_rx_write_doorbell_dqo(const struct gve_priv *priv,
+			       struct gve_rx_ring *rx);
 int gve_rx_handle_hdr_resources_dqo(struct gve_priv *priv, bool enable_hdr_split);
 
 static inline void
-gve_tx_put_doorbell_dqo(const struct gve_priv *priv,
-			const struct gve_queue_resources *q_resources, u32 val)
+gve_tx_put_doorbell_dqo(const struct gve_priv *priv, struct gve_tx_ring *tx)
 {
 	u64 index;
 
-	index = be32_to_cpu(q_resources->db_index);
-	iowrite32(val, &priv->db_bar2[index]);
+	/* The NIC already has this tail, writing it again only costs an exit */
+	if (tx->db_val == tx->dqo_tx.tail) {
+		u64_stats_update_begin(&tx->statss);
+		tx->doorbell_skipped++;
+		u64_stats_update_end(&tx->statss);
+		return;
+	}
+
+	if (static_branch_unlikely(&gve_tx_lat_key))
+		gve_tx_lat_start(priv, tx, tx->dqo_tx.last_compl_tag);
+
+	index = be32_to_cpu(tx->q_resources->db_index);
+	trace_gve_doorbell(GVE_TRACE_DB_TX, tx->q_num, tx->dqo_tx.tail);
+	iowrite32(tx->dqo_tx.tail, &priv->db_bar2[index]);
+	tx->db_val = tx->dqo_tx.tail;
+	u64_stats_update_begin(&tx->statss);
+	tx->doorbell_cnt++;
+	u64_stats_update_end(&tx->statss);
 }
 
 /* Builds register value to write to DQO IRQ doorbell to enable with specified
@@ -75,11 +92,13 @@ static inline u32 gve_setup_itr_interval_dqo(u32 interval_us)
 
 static inline void
 gve_write_irq_doorbell_dqo(const struct gve_priv *priv,
-			   const struct gve_notify_block *block, u32 val)
+			   struct gve_notify_block *block, u32 val)
 {
 	u32 index = be32_to_cpu(*block->irq_db_index);
 
+	trace_gve_doorbell(GVE_TRACE_DB_IRQ, block - priv->ntfy_blocks, val);
 	iowrite32(val, &priv->db_bar2[index]);
+	WRITE_ONCE(block->irq_doorbell_cnt, block->irq_doorbell_cnt + 1);
 }
 
 /* Sets interrupt throttling interval and enables interrupt
@@ -59,13 +59,22 @@ static const char gve_gstrings_rx_stats[][ETH_GSTRING_LEN] = {
 	"rx_xdp_aborted[%u]", "rx_xdp_drop[%u]", "rx_xdp_pass[%u]",
 	"rx_xdp_tx[%u]", "rx_xdp_redirect[%u]",
 	"rx_xdp_tx_errors[%u]", "rx_xdp_redirect_errors[%u]", "rx_xdp_alloc_fails[%u]",
+	"rx_lro_merged_pkt[%u]", "rx_lro_aggr_cnt[%u]",
+	"rx_page_aligned_pkt[%u]",
+	"rx_rsc_pkt[%u]", "rx_rsc_segs[%u]", "rx_rsc_avg_segs[%u]",
+	"rx_irq_rearm_avoided[%u]",
+	"rx_doorbells[%u]", "rx_doorbells_skipped[%u]",
+	"rx_irq_doorbells[%u]", "rx_irq_masks_skipped[%u]",
 };
 
 static const char gve_gstrings_tx_stats[][ETH_GSTRING_LEN] = {
 	"tx_posted_desc[%u]", "tx_completed_desc[%u]", "tx_consumed_desc[%u]", "tx_bytes[%u]",
 	"tx_wake[%u]", "tx_stop[%u]", "tx_event_counter[%u]",
 	"tx_dma_mapping_error[%u]", "tx_xsk_wakeup[%u]",
-	"tx_xsk_done[%u]", "tx_xsk_sent[%u]", "tx_xdp_xmit[%u]", "tx_xdp_xmit_errors[%u]"
+	"tx_xsk_done[%u]", "tx_xsk_sent[%u]", "tx_xdp_xmit[%u]", "tx_xdp_xmit_errors[%u]",
+	"tx_irq_rearm_avoided[%u]",
+	"tx_doorbells[%u]", "tx_doorbells_skipped[%u]",
+	"tx_irq_doorbells[%u]", "tx_irq_masks_skipped[%u]",
 };
 
 static const char gve_gstrings_adminq_stats[][ETH_GSTRING_LEN] = {
@@ -81,7 +90,8 @@ static const char gve_gstrings_adminq_stats[][ETH_GSTRING_LEN] = {
 
 static const char gve_gstrings_priv_flags[][ETH_GSTRING_LEN] = {
 	"report-stats", "enable-header-split", "enable-strict-header-split",
-	"enable-max-rx-buffer-size"
+	"enable-max-rx-buffer-size", "enable-rx-zerocopy",
+	"enable-max-tx-buffer-size"
 };
 
 #define GVE_MAIN_STATS_LEN  ARRAY_SIZE(gve_gstrings_main_stats)
@@ -161,11 +171,13 @@ gve_get_ethtool_stats(struct net_device *netdev,
 	u64 tmp_rx_pkts, tmp_rx_pkts_sph, tmp_rx_pkts_hbo, tmp_rx_bytes,
 		tmp_rx_hbytes, tmp_rx_skb_alloc_fail, tmp_rx_buf_alloc_fail,
 		tmp_rx_desc_err_dropped_pkt, tmp_rx_hsplit_err_dropped_pkt,
-		tmp_tx_pkts, tmp_tx_bytes;
+		tmp_rx_rsc_pkt, tmp_rx_rsc_segs, tmp_tx_pkts, tmp_tx_bytes,
+		tmp_db_cnt, tmp_db_skipped;
 	u64 rx_buf_alloc_fail, rx_desc_err_dropped_pkt, rx_hsplit_err_dropped_pkt,
 		rx_pkts, rx_pkts_sph, rx_pkts_hbo, rx_skb_alloc_fail, rx_bytes,
 		tx_pkts, tx_bytes, tx_dropped;
 	int stats_idx, base_stats_idx, max_stats_idx;
+	struct gve_notify_block *block;
 	struct stats *report_stats;
 	int *rx_qid_to_stats_idx;
 	int *tx_qid_to_stats_idx;
@@ -327,7 +339,7 @@ gve_get_ethtool_stats(struct net_device *netdev,
 					data[i++] = value;
 				}
 			}
-			/* XDP rx counters */
+			/* XDP rx and offload counters */
 			do {
 				start =	u64_stats_fetch_begin(&priv->rx[ring].statss);
 				for (j = 0; j < GVE_XDP_ACTIONS; j++)
@@ -335,9 +347,27 @@ gve_get_ethtool_stats(struct net_device *netdev,
 				data[i + j++] = rx->xdp_tx_errors;
 				data[i + j++] = rx->xdp_redirect_errors;
 				data[i + j++] = rx->xdp_alloc_fails;
+				data[i + j++] = rx->rx_lro_merged_pkt;
+				data[i + j++] = rx->rx_lro_aggr_cnt;
+				data[i + j++] = rx->rx_page_aligned_pkt;
+				tmp_rx_rsc_pkt = rx->rx_rsc_pkt;
+				tmp_rx_rsc_segs = rx->rx_rsc_segs;
+				tmp_db_cnt = rx->doorbell_cnt;
+				tmp_db_skipped = rx->doorbell_skipped;
 			} while (u64_stats_fetch_retry(&priv->rx[ring].statss,
 						       start));
-			i += GVE_XDP_ACTIONS + 3; /* XDP rx counters */
+			i += GVE_XDP_ACTIONS + 6; /* XDP rx and offload counters */
+			data[i++] = tmp_rx_rsc_pkt;
+			data[i++] = tmp_rx_rsc_segs;
+			data[i++] = tmp_rx_rsc_pkt ?
+				div64_u64(tmp_rx_rsc_segs, tmp_rx_rsc_pkt) : 0;
+			block = &priv->ntfy_blocks[gve_rx_idx_to_ntfy(priv, ring)];
+			data[i++] = READ_ONCE(block->irq_rearm_avoided);
+			data[i++] = tmp_db_cnt;
+			data[i++] = tmp_db_skipped;
+			data[i++] = READ_ONCE(block->irq_doorbell_cnt) +
+				    READ_ONCE(block->irq_mask_cnt);
+			data[i++] = READ_ONCE(block->irq_mask_skipped);
 		}
 	} else {
 		i += priv->rx_cfg.num_queues * NUM_GVE_RX_CNTS;
@@ -409,9 +439,18 @@ gve_get_ethtool_stats(struct net_device *netdev,
 				data[i] = tx->xdp_xsk_sent;
 				data[i + 1] = tx->xdp_xmit;
 				data[i + 2] = tx->xdp_xmit_errors;
+				tmp_db_cnt = tx->doorbell_cnt;
+				tmp_db_skipped = tx->doorbell_skipped;
 			} while (u64_stats_fetch_retry(&priv->tx[ring].statss,
 						       start));
 			i += 3; /* XDP tx counters */
+			block = &priv->ntfy_blocks[gve_tx_idx_to_ntfy(priv, ring)];
+			data[i++] = READ_ONCE(block->irq_rearm_avoided);
+			data[i++] = tmp_db_cnt;
+			data[i++] = tmp_db_skipped;
+			data[i++] = READ_ONCE(block->irq_doorbell_cnt) +
+				    READ_ONCE(block->irq_mask_cnt);
+			data[i++] = READ_ONCE(block->irq_mask_skipped);
 		}
 	} else {
 		i += num_tx_queues * NUM_GVE_TX_CNTS;
@@ -634,17 +673,24 @@ static int gve_set_priv_flags(struct net_device *netdev, u32 flags)
 	int new_packet_buffer_size;
 	int num_tx_queues;
 
-	/* If turning off header split, strict header split will be turned off too*/
+	/* If turning off header split, strict header split and rx zerocopy
+	 * will be turned off too
+	 */
 	if (gve_get_enable_header_split(priv) &&
 		!(flags & BIT(GVE_PRIV_FLAGS_ENABLE_HEADER_SPLIT))) {
 		flags &= ~BIT(GVE_PRIV_FLAGS_ENABLE_HEADER_SPLIT);
 		flags &= ~BIT(GVE_PRIV_FLAGS_ENABLE_STRICT_HEADER_SPLIT);
+		flags &= ~BIT(GVE_PRIV_FLAGS_ENABLE_RX_ZEROCOPY);
 	}
 
 	/* If strict header-split is requested, turn on regular header-split */
 	if (flags & BIT(GVE_PRIV_FLAGS_ENABLE_STRICT_HEADER_SPLIT))
 		flags |= BIT(GVE_PRIV_FLAGS_ENABLE_HEADER_SPLIT);
 
+	/* Rx zerocopy needs the headers split off of the payload */
+	if (flags & BIT(GVE_PRIV_FLAGS_ENABLE_RX_ZEROCOPY))
+		flags |= BIT(GVE_PRIV_FLAGS_ENABLE_HEADER_SPLIT);
+
 	/* Make sure header-split is available */
 	if ((flags & BIT(GVE_PRIV_FLAGS_ENABLE_HEADER_SPLIT)) &&
 		!(priv->ethtool_defaults & BIT(GVE_PRIV_FLAGS_ENABLE_HEADER_SPLIT))) {
@@ -660,6 +706,24 @@ static int gve_set_priv_flags(struct net_device *netdev, u32 flags)
 		return -EINVAL;
 	}
 
+	/* TCP zerocopy receive maps whole pages, so every payload buffer
+	 * must be exactly one page.
+	 */
+	if ((flags & BIT(GVE_PRIV_FLAGS_ENABLE_RX_ZEROCOPY)) &&
+			(PAGE_SIZE > GVE_MAX_RX_BUFFER_SIZE ||
+			 priv->dev_max_rx_buffer_size < PAGE_SIZE)) {
+		dev_err(&priv->pdev->dev,
+			"Rx-zerocopy not available\n");
+		return -EINVAL;
+	}
+
+	if ((flags & BIT(GVE_PRIV_FLAGS_ENABLE_MAX_TX_BUFFER_SIZE)) &&
+			priv->queue_format != GVE_DQO_QPL_FORMAT) {
+		dev_err(&priv->pdev->dev,
+			"Max-tx-buffer-size not available\n");
+		return -EINVAL;
+	}
+
 	num_tx_queues = gve_num_tx_queues(priv);
 	ori_flags = READ_ONCE(priv->ethtool_flags);
 
@@ -668,14 +732,22 @@ static int gve_set_priv_flags(struct net_device *netdev, u32 flags)
 	flag_diff = new_flags ^ ori_flags;
 
 	if ((flag_diff & BIT(GVE_PRIV_FLAGS_ENABLE_HEADER_SPLIT)) ||
-		(flag_diff & BIT(GVE_PRIV_FLAGS_ENABLE_MAX_RX_BUFFER_SIZE))) {
+		(flag_diff & BIT(GVE_PRIV_FLAGS_ENABLE_MAX_RX_BUFFER_SIZE)) ||
+		(flag_diff & BIT(GVE_PRIV_FLAGS_ENABLE_RX_ZEROCOPY))) {
 		bool enable_hdr_split =
 			new_flags & BIT(GVE_PRIV_FLAGS_ENABLE_HEADER_SPLIT);
 		bool enable_max_buffer_size =
 			new_flags & BIT(GVE_PRIV_FLAGS_ENABLE_MAX_RX_BUFFER_SIZE);
+		bool enable_rx_zerocopy =
+			new_flags & BIT(GVE_PRIV_FLAGS_ENABLE_RX_ZEROCOPY);
 		int err;
 
-		if (enable_max_buffer_size)
+		/* One page per buffer also keeps the buffers page-aligned,
+		 * as they are never split into smaller ones.
+		 */
+		if (enable_rx_zerocopy)
+			new_packet_buffer_size = PAGE_SIZE;
+		else if (enable_max_buffer_size)
 			new_packet_buffer_size = priv->dev_max_rx_buffer_size;
 		else
 			new_packet_buffer_size = GVE_RX_BUFFER_SIZE_DQO;
@@ -687,6 +759,20 @@ static int gve_set_priv_flags(struct net_device *netdev, u32 flags)
 			return err;
 	}
 
+	/* Resets the link: a running interface is closed and reopened so the
+	 * TX rings are reallocated with the new bounce buffer size.
+	 */
+	if (flag_diff & BIT(GVE_PRIV_FLAGS_ENABLE_MAX_TX_BUFFER_SIZE)) {
+		bool enable_max_tx_buffer_size =
+			new_flags & BIT(GVE_PRIV_FLAGS_ENABLE_MAX_TX_BUFFER_SIZE);
+		int err;
+
+		err = gve_reconfigure_tx_buf_size(priv,
+						  enable_max_tx_buffer_size);
+		if (err)
+			return err;
+	}
+
 	priv->ethtool_flags = new_flags;
 
 	/* start report-stats timer when user turns report stats on. */
@@ -0,0 +1,24 @@
+/* SPDX-License-Identifier: (GPL-2.0 OR MIT)
+ * Google virtual Ethernet (gve) driver
+ *
+ * Copyright (C) 2015-2024 Google, Inc.
+ */
+
+#ifndef _GVE_KUNIT_H
+#define _GVE_KUNIT_H
+
+#include <kunit/test.h>
+#include <linux/timex.h>
+
+/* Runs `stmt` and logs the cycles it took, so a regression in the function
+ * under test shows up next to the case in the kunit.py output.
+ */
+#define GVE_KUNIT_CYCLES(test, stmt) do {				\
+	cycles_t __start = get_cycles();				\
+									\
+	stmt;								\
+	kunit_info(test, "%s: %llu cycles\n", #stmt,			\
+		   (unsigned long long)(get_cycles() - __start));	\
+} while (0)
+
+#endif /* _GVE_KUNIT_H */
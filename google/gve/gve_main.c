@@ -9,6 +9,7 @@
 #include <linux/etherdevice.h>
 #include <linux/filter.h>
 #include <linux/interrupt.h>
+#include <linux/irq.h>
 #include <linux/module.h>
 #include <linux/pci.h>
 #include <linux/sched.h>
@@ -16,6 +17,7 @@
 #include <linux/workqueue.h>
 #include <linux/utsname.h>
 #include <linux/version.h>
+#include <net/netdev_queues.h>
 #include <net/sch_generic.h>
 #include <net/xdp_sock_drv.h>
 #include "gve.h"
@@ -23,6 +25,9 @@
 #include "gve_adminq.h"
 #include "gve_register.h"
 
+#define CREATE_TRACE_POINTS
+#include "gve_trace.h"
+
 #define GVE_DEFAULT_RX_COPYBREAK	(256)
 
 #define DEFAULT_MSG_LEVEL	(NETIF_MSG_DRV | NETIF_MSG_LINK)
@@ -291,12 +296,33 @@ static irqreturn_t gve_mgmnt_intr(int irq, void *arg)
 	return IRQ_HANDLED;
 }
 
+/* Tracks the mask state so that gve_intr() can skip masking an irq that is
+ * already masked.
+ */
+static void gve_write_irq_doorbell(struct gve_priv *priv,
+				   struct gve_notify_block *block, u32 val)
+{
+	WRITE_ONCE(block->irq_masked, !!(val & GVE_IRQ_MASK));
+	trace_gve_doorbell(GVE_TRACE_DB_IRQ, block - priv->ntfy_blocks, val);
+	iowrite32be(val, gve_irq_doorbell(priv, block));
+	WRITE_ONCE(block->irq_doorbell_cnt, block->irq_doorbell_cnt + 1);
+}
+
 static irqreturn_t gve_intr(int irq, void *arg)
 {
 	struct gve_notify_block *block = arg;
 	struct gve_priv *priv = block->priv;
 
-	iowrite32be(GVE_IRQ_MASK, gve_irq_doorbell(priv, block));
+	if (READ_ONCE(block->irq_masked)) {
+		WRITE_ONCE(block->irq_mask_skipped,
+			   block->irq_mask_skipped + 1);
+	} else {
+		WRITE_ONCE(block->irq_masked, true);
+		trace_gve_doorbell(GVE_TRACE_DB_IRQ, block - priv->ntfy_blocks,
+				   GVE_IRQ_MASK);
+		iowrite32be(GVE_IRQ_MASK, gve_irq_doorbell(priv, block));
+		WRITE_ONCE(block->irq_mask_cnt, block->irq_mask_cnt + 1);
+	}
 	napi_schedule_irqoff(&block->napi);
 	return IRQ_HANDLED;
 }
@@ -310,10 +336,27 @@ static irqreturn_t gve_intr_dqo(int irq, void *arg)
 	return IRQ_HANDLED;
 }
 
+/* dev_set_threaded() starts and stops the NAPI kthreads without calling into
+ * the driver, so a new kthread is noticed from its first poll. Pinning may
+ * sleep, so the service task does it.
+ */
+static void gve_napi_check_thread(struct gve_notify_block *block)
+{
+	struct gve_priv *priv = block->priv;
+
+	if (likely(READ_ONCE(block->napi.thread) ==
+		   READ_ONCE(block->pinned_thread)))
+		return;
+
+	if (!gve_get_do_pin_napi_threads(priv)) {
+		gve_set_do_pin_napi_threads(priv);
+		queue_work(priv->gve_wq, &priv->service_task);
+	}
+}
+
 static int gve_napi_poll(struct napi_struct *napi, int budget)
 {
 	struct gve_notify_block *block;
-	__be32 __iomem *irq_doorbell;
 	bool reschedule = false;
 	struct gve_priv *priv;
 	int work_done = 0;
@@ -321,6 +364,8 @@ static int gve_napi_poll(struct napi_struct *napi, int budget)
 	block = container_of(napi, struct gve_notify_block, napi);
 	priv = block->priv;
 
+	gve_napi_check_thread(block);
+
 	if (block->tx) {
 		if (block->tx->q_num < priv->tx_cfg.num_queues)
 			reschedule |= gve_tx_poll(block, budget);
@@ -333,13 +378,15 @@ static int gve_napi_poll(struct napi_struct *napi, int budget)
 		reschedule |= work_done == budget;
 	}
 
+	if (static_branch_unlikely(&gve_napi_hist_key))
+		gve_napi_hist_update(block, work_done, reschedule);
+
 	if (reschedule)
 		return budget;
 
        /* Complete processing - don't unmask irq if busy polling is enabled */
 	if (likely(napi_complete_done(napi, work_done))) {
-		irq_doorbell = gve_irq_doorbell(priv, block);
-		iowrite32be(GVE_IRQ_ACK | GVE_IRQ_EVENT, irq_doorbell);
+		gve_write_irq_doorbell(priv, block, GVE_IRQ_ACK | GVE_IRQ_EVENT);
 
 		/* Ensure IRQ ACK is visible before we check pending work.
 		 * If queue had issued updates, it would be truly visible.
@@ -352,7 +399,13 @@ static int gve_napi_poll(struct napi_struct *napi, int budget)
 			reschedule |= gve_rx_work_pending(block->rx);
 
 		if (reschedule && napi_reschedule(napi))
-			iowrite32be(GVE_IRQ_MASK, irq_doorbell);
+			gve_write_irq_doorbell(priv, block, GVE_IRQ_MASK);
+	} else {
+		/* Busy polling, deferred hard irqs or irq suspension own the
+		 * napi, the irq stays masked until they hand it back.
+		 */
+		WRITE_ONCE(block->irq_rearm_avoided,
+			   block->irq_rearm_avoided + 1);
 	}
 	return work_done;
 }
@@ -365,6 +418,8 @@ static int gve_napi_poll_dqo(struct napi_struct *napi, int budget)
 	bool reschedule = false;
 	int work_done = 0;
 
+	gve_napi_check_thread(block);
+
 	if (block->tx)
 		reschedule |= gve_tx_poll_dqo(block, /*do_clean=*/true);
 
@@ -373,6 +428,9 @@ static int gve_napi_poll_dqo(struct napi_struct *napi, int budget)
 		reschedule |= work_done == budget;
 	}
 
+	if (static_branch_unlikely(&gve_napi_hist_key))
+		gve_napi_hist_update(block, work_done, reschedule);
+
 	if (reschedule)
 		return budget;
 
@@ -387,11 +445,31 @@ static int gve_napi_poll_dqo(struct napi_struct *napi, int budget)
 		 */
 		gve_write_irq_doorbell_dqo(priv, block,
 					   GVE_ITR_NO_UPDATE_DQO | GVE_ITR_ENABLE_BIT_DQO);
+	} else {
+		/* The irq was masked by hardware when it fired */
+		WRITE_ONCE(block->irq_rearm_avoided,
+			   block->irq_rearm_avoided + 1);
 	}
 
 	return work_done;
 }
 
+static void gve_irq_affinity_notify(struct irq_affinity_notify *notify,
+				    const cpumask_t *mask)
+{
+	struct gve_notify_block *block =
+		container_of(notify, struct gve_notify_block, affinity_notify);
+	struct gve_priv *priv = block->priv;
+
+	gve_set_do_pin_napi_threads(priv);
+	queue_work(priv->gve_wq, &priv->service_task);
+}
+
+static void gve_irq_affinity_release(struct kref *ref)
+{
+	/* The notifier is embedded in its notify block, nothing to free */
+}
+
 static int gve_alloc_notify_blocks(struct gve_priv *priv)
 {
 	int num_vecs_requested = priv->num_ntfy_blks + 1;
@@ -481,6 +559,10 @@ static int gve_alloc_notify_blocks(struct gve_priv *priv)
 		}
 		irq_set_affinity_hint(priv->msix_vectors[msix_idx].vector,
 				      get_cpu_mask(i % active_cpus));
+		block->affinity_notify.notify = gve_irq_affinity_notify;
+		block->affinity_notify.release = gve_irq_affinity_release;
+		irq_set_affinity_notifier(priv->msix_vectors[msix_idx].vector,
+					  &block->affinity_notify);
 		block->irq_db_index = &priv->irq_db_indices[i].index;
 	}
 	return 0;
@@ -489,6 +571,8 @@ abort_with_some_ntfy_blocks:
 		struct gve_notify_block *block = &priv->ntfy_blocks[j];
 		int msix_idx = j;
 
+		irq_set_affinity_notifier(priv->msix_vectors[msix_idx].vector,
+					  NULL);
 		irq_set_affinity_hint(priv->msix_vectors[msix_idx].vector,
 				      NULL);
 		free_irq(priv->msix_vectors[msix_idx].vector, block);
@@ -522,6 +606,8 @@ static void gve_free_notify_blocks(struct gve_priv *priv)
 		struct gve_notify_block *block = &priv->ntfy_blocks[i];
 		int msix_idx = i;
 
+		irq_set_affinity_notifier(priv->msix_vectors[msix_idx].vector,
+					  NULL);
 		irq_set_affinity_hint(priv->msix_vectors[msix_idx].vector,
 				      NULL);
 		free_irq(priv->msix_vectors[msix_idx].vector, block);
@@ -647,6 +733,7 @@ static void gve_add_napi(struct gve_priv *priv, int ntfy_idx,
 	struct gve_notify_block *block = &priv->ntfy_blocks[ntfy_idx];
 
 	netif_napi_add(priv->dev, &block->napi, gve_poll);
+	netif_napi_set_irq(&block->napi, priv->msix_vectors[ntfy_idx].vector);
 }
 
 static void gve_remove_napi(struct gve_priv *priv, int ntfy_idx)
@@ -1083,16 +1170,20 @@ static void gve_free_rings(struct gve_priv *priv)
 	}
 }
 
-int gve_alloc_page(struct gve_priv *priv, struct device *dev,
-		   struct page **page, dma_addr_t *dma,
-		   enum dma_data_direction dir, gfp_t gfp_flags)
+int gve_alloc_pages(struct gve_priv *priv, struct device *dev,
+		    struct page **page, dma_addr_t *dma,
+		    enum dma_data_direction dir, gfp_t gfp_flags,
+		    unsigned int order)
 {
-	*page = alloc_page(gfp_flags);
+	if (order)
+		gfp_flags |= __GFP_COMP | __GFP_NOWARN;
+
+	*page = alloc_pages(gfp_flags, order);
 	if (!*page) {
 		priv->page_alloc_fail++;
 		return -ENOMEM;
 	}
-	*dma = dma_map_page(dev, *page, 0, PAGE_SIZE, dir);
+	*dma = dma_map_page(dev, *page, 0, PAGE_SIZE << order, dir);
 	if (dma_mapping_error(dev, *dma)) {
 		priv->dma_mapping_error++;
 		put_page(*page);
@@ -1101,6 +1192,13 @@ int gve_alloc_page(struct gve_priv *priv, struct device *dev,
 	return 0;
 }
 
+int gve_alloc_page(struct gve_priv *priv, struct device *dev,
+		   struct page **page, dma_addr_t *dma,
+		   enum dma_data_direction dir, gfp_t gfp_flags)
+{
+	return gve_alloc_pages(priv, dev, page, dma, dir, gfp_flags, 0);
+}
+
 static int gve_alloc_queue_page_list(struct gve_priv *priv, u32 id,
 				     int pages)
 {
@@ -1141,15 +1239,21 @@ static int gve_alloc_queue_page_list(struct gve_priv *priv, u32 id,
 	return 0;
 }
 
-void gve_free_page(struct device *dev, struct page *page, dma_addr_t dma,
-		   enum dma_data_direction dir)
+void gve_free_pages(struct device *dev, struct page *page, dma_addr_t dma,
+		    enum dma_data_direction dir, unsigned int order)
 {
 	if (!dma_mapping_error(dev, dma))
-		dma_unmap_page(dev, dma, PAGE_SIZE, dir);
+		dma_unmap_page(dev, dma, PAGE_SIZE << order, dir);
 	if (page)
 		put_page(page);
 }
 
+void gve_free_page(struct device *dev, struct page *page, dma_addr_t dma,
+		   enum dma_data_direction dir)
+{
+	gve_free_pages(dev, page, dma, dir, 0);
+}
+
 static void gve_free_queue_page_list(struct gve_priv *priv, u32 id)
 {
 	struct gve_queue_page_list *qpl = &priv->qpls[id];
@@ -1284,6 +1388,7 @@ static void gve_free_qpls(struct gve_priv *priv)
  */
 void gve_schedule_reset(struct gve_priv *priv)
 {
+	trace_gve_schedule_reset(priv, _RET_IP_);
 	gve_set_do_reset(priv);
 	queue_work(priv->gve_wq, &priv->service_task);
 }
@@ -1528,6 +1633,37 @@ err:
 	return err;
 }
 
+int gve_reconfigure_tx_buf_size(struct gve_priv *priv, bool enable_max)
+{
+	int err;
+
+	/* The TX bounce buffer size is picked when the rings are allocated */
+	if (netif_carrier_ok(priv->dev)) {
+		err = gve_close(priv->dev);
+		if (err)
+			return err;
+		assign_bit(GVE_PRIV_FLAGS_ENABLE_MAX_TX_BUFFER_SIZE,
+			   &priv->ethtool_flags, enable_max);
+
+		err = gve_open(priv->dev);
+		if (err)
+			goto err;
+		return 0;
+	}
+
+	assign_bit(GVE_PRIV_FLAGS_ENABLE_MAX_TX_BUFFER_SIZE,
+		   &priv->ethtool_flags, enable_max);
+
+	return 0;
+
+err:
+	dev_err(&priv->pdev->dev,
+		"Failed to reconfigure tx buffer size: err=%d. Disabling all queues.\n",
+		err);
+	gve_turndown(priv);
+	return err;
+}
+
 static int gve_remove_xdp_queues(struct gve_priv *priv)
 {
 	int err;
@@ -1638,7 +1774,7 @@ int gve_reconfigure_rx_rings(struct gve_priv *priv,
         gve_turndown(priv);
 
         /* Allocate/free hdr resources */
-	if (enable_hdr_split != !!priv->header_buf_pool) {
+	if (enable_hdr_split != !!priv->header_buf_truesize) {
 		err = gve_rx_handle_hdr_resources_dqo(priv, enable_hdr_split);
 		if (err)
 			goto err;
@@ -1971,12 +2107,18 @@ static void gve_turndown(struct gve_priv *priv)
 		int ntfy_idx = gve_tx_idx_to_ntfy(priv, idx);
 		struct gve_notify_block *block = &priv->ntfy_blocks[ntfy_idx];
 
+		/* XDP tx queues are not netdev queues */
+		if (idx < priv->tx_cfg.num_queues)
+			netif_queue_set_napi(priv->dev, idx,
+					     NETDEV_QUEUE_TYPE_TX, NULL);
 		napi_disable(&block->napi);
 	}
 	for (idx = 0; idx < priv->rx_cfg.num_queues; idx++) {
 		int ntfy_idx = gve_rx_idx_to_ntfy(priv, idx);
 		struct gve_notify_block *block = &priv->ntfy_blocks[ntfy_idx];
 
+		netif_queue_set_napi(priv->dev, idx,
+				     NETDEV_QUEUE_TYPE_RX, NULL);
 		napi_disable(&block->napi);
 	}
 
@@ -1987,6 +2129,31 @@ static void gve_turndown(struct gve_priv *priv)
 	gve_clear_report_stats(priv);
 }
 
+/* Threaded NAPI kthreads follow the affinity of their block's irq, so
+ * /proc/irq/<n>/smp_affinity pins the packet processing of a queue.
+ */
+static void gve_pin_napi_thread(struct gve_priv *priv, int ntfy_idx)
+{
+	struct gve_notify_block *block = &priv->ntfy_blocks[ntfy_idx];
+	unsigned int irq = priv->msix_vectors[ntfy_idx].vector;
+	const struct cpumask *mask = irq_get_affinity_mask(irq);
+
+	/* The kthread only exists while threaded NAPI is enabled */
+	if (block->napi.thread && mask)
+		set_cpus_allowed_ptr(block->napi.thread, mask);
+	WRITE_ONCE(block->pinned_thread, block->napi.thread);
+}
+
+static void gve_pin_napi_threads(struct gve_priv *priv)
+{
+	int idx;
+
+	for (idx = 0; idx < gve_num_tx_queues(priv); idx++)
+		gve_pin_napi_thread(priv, gve_tx_idx_to_ntfy(priv, idx));
+	for (idx = 0; idx < priv->rx_cfg.num_queues; idx++)
+		gve_pin_napi_thread(priv, gve_rx_idx_to_ntfy(priv, idx));
+}
+
 static void gve_turnup(struct gve_priv *priv)
 {
 	int idx;
@@ -2000,8 +2167,13 @@ static void gve_turnup(struct gve_priv *priv)
 		struct gve_notify_block *block = &priv->ntfy_blocks[ntfy_idx];
 
 		napi_enable(&block->napi);
+		/* Expose the queue to napi mapping through netdev netlink */
+		if (idx < priv->tx_cfg.num_queues)
+			netif_queue_set_napi(priv->dev, idx,
+					     NETDEV_QUEUE_TYPE_TX,
+					     &block->napi);
 		if (gve_is_gqi(priv)) {
-			iowrite32be(0, gve_irq_doorbell(priv, block));
+			gve_write_irq_doorbell(priv, block, 0);
 		} else {
 			gve_set_itr_coalesce_usecs_dqo(priv, block,
 						       priv->tx_coalesce_usecs);
@@ -2012,14 +2184,17 @@ static void gve_turnup(struct gve_priv *priv)
 		struct gve_notify_block *block = &priv->ntfy_blocks[ntfy_idx];
 
 		napi_enable(&block->napi);
+		netif_queue_set_napi(priv->dev, idx, NETDEV_QUEUE_TYPE_RX,
+				     &block->napi);
 		if (gve_is_gqi(priv)) {
-			iowrite32be(0, gve_irq_doorbell(priv, block));
+			gve_write_irq_doorbell(priv, block, 0);
 		} else {
 			gve_set_itr_coalesce_usecs_dqo(priv, block,
 						       priv->rx_coalesce_usecs);
 		}
 	}
 
+	gve_pin_napi_threads(priv);
 	gve_set_napi_enabled(priv);
 }
 
@@ -2054,7 +2229,7 @@ static void gve_tx_timeout(struct net_device *dev, unsigned int txqueue)
 	last_nic_done = gve_tx_load_event_counter(priv, tx);
 	if (last_nic_done - tx->done) {
 		netdev_info(dev, "Kicking queue %d", txqueue);
-		iowrite32be(GVE_IRQ_MASK, gve_irq_doorbell(priv, block));
+		gve_write_irq_doorbell(priv, block, GVE_IRQ_MASK);
 		napi_schedule(&block->napi);
 		tx->last_kick_msec = current_time;
 		goto out;
@@ -2077,7 +2252,20 @@ static int gve_set_features(struct net_device *netdev,
 	int err;
 
 	if ((netdev->features & NETIF_F_LRO) != (features & NETIF_F_LRO)) {
+		if ((features & NETIF_F_LRO) && priv->xdp_prog) {
+			netdev_warn(netdev, "LRO is not supported when XDP is on.\n");
+			return -EOPNOTSUPP;
+		}
+
+		/* GQI does LRO in software and picks up the change on the next
+		 * poll.
+		 */
 		netdev->features ^= NETIF_F_LRO;
+	}
+
+	if ((netdev->features & NETIF_F_GRO_HW) != (features & NETIF_F_GRO_HW)) {
+		netdev->features ^= NETIF_F_GRO_HW;
+		/* RSC is set up when DQO queues are created */
 		if (netif_carrier_ok(netdev)) {
 			/* To make this process as simple as possible we
 			 * teardown the device, set the new configuration,
@@ -2120,6 +2308,92 @@ static const struct net_device_ops gve_netdev_ops = {
 	.ndo_xsk_wakeup		=	gve_xsk_wakeup,
 };
 
+static void gve_get_rx_queue_stats(struct net_device *dev, int idx,
+				   struct netdev_queue_stats_rx *rx_stats)
+{
+	struct gve_priv *priv = netdev_priv(dev);
+	struct gve_rx_ring *rx;
+	unsigned int start;
+
+	if (!priv->rx)
+		return;
+
+	rx = &priv->rx[idx];
+	do {
+		start = u64_stats_fetch_begin(&rx->statss);
+		rx_stats->packets = rx->rpackets;
+		rx_stats->bytes = rx->rbytes;
+		rx_stats->alloc_fail = rx->rx_skb_alloc_fail +
+				       rx->rx_buf_alloc_fail;
+		rx_stats->hw_gro_packets = rx->rx_rsc_pkt;
+		rx_stats->hw_gro_wire_packets = rx->rx_rsc_segs;
+	} while (u64_stats_fetch_retry(&rx->statss, start));
+}
+
+static void gve_get_tx_queue_stats(struct net_device *dev, int idx,
+				   struct netdev_queue_stats_tx *tx_stats)
+{
+	struct gve_priv *priv = netdev_priv(dev);
+	struct gve_tx_ring *tx;
+	unsigned int start;
+
+	if (!priv->tx)
+		return;
+
+	tx = &priv->tx[idx];
+	do {
+		start = u64_stats_fetch_begin(&tx->statss);
+		tx_stats->packets = tx->pkt_done;
+		tx_stats->bytes = tx->bytes_done;
+	} while (u64_stats_fetch_retry(&tx->statss, start));
+	tx_stats->stop = tx->stop_queue;
+	tx_stats->wake = tx->wake_queue;
+}
+
+/* The XDP tx rings are not netdev queues, account for them here so that the
+ * queue stats add up to what ndo_get_stats64 reports.
+ */
+static void gve_get_base_stats(struct net_device *dev,
+			       struct netdev_queue_stats_rx *rx,
+			       struct netdev_queue_stats_tx *tx)
+{
+	struct gve_priv *priv = netdev_priv(dev);
+	u64 packets, bytes;
+	unsigned int start;
+	int ring;
+
+	rx->packets = 0;
+	rx->bytes = 0;
+	rx->alloc_fail = 0;
+	rx->hw_gro_packets = 0;
+	rx->hw_gro_wire_packets = 0;
+
+	tx->packets = 0;
+	tx->bytes = 0;
+	tx->stop = 0;
+	tx->wake = 0;
+
+	if (!priv->tx)
+		return;
+
+	for (ring = priv->tx_cfg.num_queues; ring < gve_num_tx_queues(priv);
+	     ring++) {
+		do {
+			start = u64_stats_fetch_begin(&priv->tx[ring].statss);
+			packets = priv->tx[ring].pkt_done;
+			bytes = priv->tx[ring].bytes_done;
+		} while (u64_stats_fetch_retry(&priv->tx[ring].statss, start));
+		tx->packets += packets;
+		tx->bytes += bytes;
+	}
+}
+
+static const struct netdev_stat_ops gve_stat_ops = {
+	.get_queue_stats_rx	= gve_get_rx_queue_stats,
+	.get_queue_stats_tx	= gve_get_tx_queue_stats,
+	.get_base_stats		= gve_get_base_stats,
+};
+
 static void gve_handle_status(struct gve_priv *priv, u32 status)
 {
 	if (GVE_DEVICE_STATUS_RESET_MASK & status) {
@@ -2148,6 +2422,19 @@ static void gve_handle_reset(struct gve_priv *priv)
 	}
 }
 
+static void gve_handle_pin_napi_threads(struct gve_priv *priv)
+{
+	if (!gve_get_do_pin_napi_threads(priv))
+		return;
+
+	gve_clear_do_pin_napi_threads(priv);
+	/* The kthreads come and go with the queues, which rtnl protects */
+	rtnl_lock();
+	if (gve_get_napi_enabled(priv))
+		gve_pin_napi_threads(priv);
+	rtnl_unlock();
+}
+
 void gve_handle_report_stats(struct gve_priv *priv)
 {
 	struct stats *stats = priv->stats_report->stats;
@@ -2217,7 +2504,7 @@ void gve_handle_report_stats(struct gve_priv *priv)
 			};
 			stats[stats_idx++] = (struct stats) {
 				.stat_name = cpu_to_be32(RX_BUFFERS_POSTED),
-				.value = cpu_to_be64(priv->rx[0].fill_cnt),
+				.value = cpu_to_be64(priv->rx[idx].fill_cnt),
 				.queue_id = cpu_to_be32(idx),
 			};
 		}
@@ -2234,6 +2521,7 @@ static void gve_service_task(struct work_struct *work)
 	gve_handle_status(priv, status);
 
 	gve_handle_reset(priv);
+	gve_handle_pin_napi_threads(priv);
 	gve_handle_link_status(priv, GVE_DEVICE_STATUS_LINK_STATUS_MASK & status);
 }
 
@@ -2302,6 +2590,7 @@ static int gve_init_priv(struct gve_priv *priv, bool skip_describe_device)
 
 	priv->num_registered_pages = 0;
 	priv->rx_copybreak = GVE_DEFAULT_RX_COPYBREAK;
+	priv->rx_db_batch = GVE_DEFAULT_RX_DB_BATCH;
 	/* gvnic has one Notification Block per MSI-x vector, except for the
 	 * management vector
 	 */
@@ -2492,6 +2781,7 @@ static int gve_probe(struct pci_dev *pdev, const struct pci_device_id *ent)
 	pci_set_drvdata(pdev, dev);
 	dev->ethtool_ops = &gve_ethtool_ops;
 	dev->netdev_ops = &gve_netdev_ops;
+	dev->stat_ops = &gve_stat_ops;
 
 	/* Set default and supported features.
 	 *
@@ -2542,6 +2832,8 @@ static int gve_probe(struct pci_dev *pdev, const struct pci_device_id *ent)
 	if (err)
 		goto abort_with_gve_init;
 
+	gve_debugfs_init(priv);
+
 	dev_info(&pdev->dev, "GVE version %s\n", gve_version_str);
 	dev_info(&pdev->dev, "GVE queue format %d\n", (int)priv->queue_format);
 	gve_clear_probe_in_progress(priv);
@@ -2578,6 +2870,7 @@ static void gve_remove(struct pci_dev *pdev)
 	__be32 __iomem *db_bar = priv->db_bar2;
 	void __iomem *reg_bar = priv->reg_bar0;
 
+	gve_debugfs_exit(priv);
 	unregister_netdev(netdev);
 	gve_teardown_priv_resources(priv);
 	destroy_workqueue(priv->gve_wq);
@@ -2704,7 +2997,25 @@ static struct pci_driver gve_driver = {
 #endif
 };
 
-module_pci_driver(gve_driver);
+static int __init gve_init_module(void)
+{
+	int err;
+
+	gve_debugfs_create_root();
+	err = pci_register_driver(&gve_driver);
+	if (err)
+		gve_debugfs_destroy_root();
+	return err;
+}
+
+static void __exit gve_exit_module(void)
+{
+	pci_unregister_driver(&gve_driver);
+	gve_debugfs_destroy_root();
+}
+
+module_init(gve_init_module);
+module_exit(gve_exit_module);
 
 MODULE_DEVICE_TABLE(pci, gve_id_table);
 MODULE_AUTHOR("Google, Inc.");
@@ -6,9 +6,14 @@
 
 #include "gve.h"
 #include "gve_adminq.h"
+#include "gve_trace.h"
 #include "gve_utils.h"
 #include <linux/etherdevice.h>
 #include <linux/filter.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+#include <linux/tcp.h>
+#include <net/ip6_checksum.h>
 #include <net/xdp.h>
 #include <net/xdp_sock_drv.h>
 
@@ -328,7 +333,39 @@ void gve_rx_write_doorbell(struct gve_priv *priv, struct gve_rx_ring *rx)
 {
 	u32 db_idx = be32_to_cpu(rx->q_resources->db_index);
 
+	/* Nothing was posted since the last write */
+	if (rx->db_fill_cnt == rx->fill_cnt) {
+		u64_stats_update_begin(&rx->statss);
+		rx->doorbell_skipped++;
+		u64_stats_update_end(&rx->statss);
+		return;
+	}
+
+	trace_gve_doorbell(GVE_TRACE_DB_RX, rx->q_num, rx->fill_cnt);
 	iowrite32be(rx->fill_cnt, &priv->db_bar2[db_idx]);
+	rx->db_fill_cnt = rx->fill_cnt;
+	u64_stats_update_begin(&rx->statss);
+	rx->doorbell_cnt++;
+	u64_stats_update_end(&rx->statss);
+}
+
+/* Holds back the doorbell until a batch of buffers has been posted, as long as
+ * the NIC still has more than db_threshold buffers to fill.
+ */
+static void gve_rx_maybe_write_doorbell(struct gve_priv *priv,
+					struct gve_rx_ring *rx)
+{
+	u32 batch = gve_rx_db_batch(priv, rx->mask + 1);
+
+	if (rx->fill_cnt - rx->db_fill_cnt < batch &&
+	    rx->db_fill_cnt - rx->cnt > rx->db_threshold) {
+		u64_stats_update_begin(&rx->statss);
+		rx->doorbell_skipped++;
+		u64_stats_update_end(&rx->statss);
+		return;
+	}
+
+	gve_rx_write_doorbell(priv, rx);
 }
 
 static enum pkt_hash_types gve_rss_type(__be16 pkt_flags)
@@ -430,7 +467,8 @@ gve_rx_raw_addressing(struct device *dev, struct net_device *netdev,
 
 static struct sk_buff *gve_rx_copy_to_pool(struct gve_rx_ring *rx,
 					   struct gve_rx_slot_page_info *page_info,
-					   u16 len, struct napi_struct *napi)
+					   u16 len, struct napi_struct *napi,
+					   struct gve_rx_cnts *cnts)
 {
 	u32 pool_idx = rx->qpl_copy_pool_head & rx->qpl_copy_pool_mask;
 	void *src = page_info->page_address + page_info->page_offset;
@@ -475,10 +513,8 @@ static struct sk_buff *gve_rx_copy_to_pool(struct gve_rx_ring *rx,
 				       rx->packet_buffer_size,
 				       len, ctx);
 
-		u64_stats_update_begin(&rx->statss);
-		rx->rx_frag_copy_cnt++;
-		rx->rx_frag_alloc_cnt++;
-		u64_stats_update_end(&rx->statss);
+		cnts->frag_copy_cnt++;
+		cnts->frag_alloc_cnt++;
 
 		return skb;
 	}
@@ -507,9 +543,41 @@ static struct sk_buff *gve_rx_copy_to_pool(struct gve_rx_ring *rx,
 		copy_page_info->can_flip = true;
 	}
 
-	u64_stats_update_begin(&rx->statss);
-	rx->rx_frag_copy_cnt++;
-	u64_stats_update_end(&rx->statss);
+	cnts->frag_copy_cnt++;
+
+	return skb;
+}
+
+/* Returns true if a packet fits in its buffer along with the
+ * skb_shared_info that napi_build_skb() places behind it.
+ */
+static bool gve_rx_can_build_skb(struct gve_rx_slot_page_info *page_info,
+				 u16 packet_buffer_size, u16 len)
+{
+	return page_info->pad + len +
+		SKB_DATA_ALIGN(sizeof(struct skb_shared_info)) <=
+		packet_buffer_size;
+}
+
+/* Builds a linear skb around the buffer, with the headers already in the
+ * linear area, rather than attaching the buffer as a frag that the stack
+ * then has to pull the headers out of.
+ */
+static struct sk_buff *
+gve_rx_build_skb(struct net_device *netdev,
+		 struct gve_rx_slot_page_info *page_info,
+		 u16 packet_buffer_size, u16 len)
+{
+	void *va = page_info->page_address + page_info->page_offset;
+	struct sk_buff *skb;
+
+	skb = napi_build_skb(va, packet_buffer_size);
+	if (unlikely(!skb))
+		return NULL;
+
+	skb_reserve(skb, page_info->pad);
+	__skb_put(skb, len);
+	skb->protocol = eth_type_trans(skb, netdev);
 
 	return skb;
 }
@@ -518,7 +586,8 @@ static struct sk_buff *
 gve_rx_qpl(struct device *dev, struct net_device *netdev,
 	   struct gve_rx_ring *rx, struct gve_rx_slot_page_info *page_info,
 	   u16 len, struct napi_struct *napi,
-	   union gve_rx_data_slot *data_slot)
+	   union gve_rx_data_slot *data_slot, bool is_only_frag,
+	   struct gve_rx_cnts *cnts)
 {
 	struct gve_rx_ctx *ctx = &rx->ctx;
 	struct sk_buff *skb;
@@ -529,7 +598,16 @@ gve_rx_qpl(struct device *dev, struct net_device *netdev,
 	 * device.
 	 */
 	if (page_info->can_flip) {
-		skb = gve_rx_add_frags(napi, page_info, rx->packet_buffer_size, len, ctx);
+		/* The skb owns this half of the page until it is freed, just
+		 * as it would own it as a frag.
+		 */
+		if (is_only_frag &&
+		    gve_rx_can_build_skb(page_info, rx->packet_buffer_size, len))
+			skb = gve_rx_build_skb(netdev, page_info,
+					       rx->packet_buffer_size, len);
+		else
+			skb = gve_rx_add_frags(napi, page_info,
+					       rx->packet_buffer_size, len, ctx);
 		/* No point in recycling if we didn't get the skb */
 		if (skb) {
 			/* Make sure that the page isn't freed. */
@@ -537,7 +615,7 @@ gve_rx_qpl(struct device *dev, struct net_device *netdev,
 			gve_rx_flip_buff(page_info, &data_slot->qpl_offset);
 		}
 	} else {
-		skb = gve_rx_copy_to_pool(rx, page_info, len, napi);
+		skb = gve_rx_copy_to_pool(rx, page_info, len, napi, cnts);
 	}
 	return skb;
 }
@@ -545,7 +623,7 @@ gve_rx_qpl(struct device *dev, struct net_device *netdev,
 static struct sk_buff *gve_rx_skb(struct gve_priv *priv, struct gve_rx_ring *rx,
 				  struct gve_rx_slot_page_info *page_info, struct napi_struct *napi,
 				  u16 len, union gve_rx_data_slot *data_slot,
-				  bool is_only_frag)
+				  bool is_only_frag, struct gve_rx_cnts *cnts)
 {
 	struct net_device *netdev = priv->dev;
 	struct gve_rx_ctx *ctx = &rx->ctx;
@@ -555,11 +633,9 @@ static struct sk_buff *gve_rx_skb(struct gve_priv *priv, struct gve_rx_ring *rx,
 		/* Just copy small packets */
 		skb = gve_rx_copy(netdev, napi, page_info, len);
 		if (skb) {
-			u64_stats_update_begin(&rx->statss);
-			rx->rx_copied_pkt++;
-			rx->rx_frag_copy_cnt++;
-			rx->rx_copybreak_pkt++;
-			u64_stats_update_end(&rx->statss);
+			cnts->copied_pkt_cnt++;
+			cnts->frag_copy_cnt++;
+			cnts->copybreak_pkt_cnt++;
 		}
 	} else {
 		int recycle = gve_rx_can_recycle_buffer(page_info);
@@ -569,11 +645,7 @@ static struct sk_buff *gve_rx_skb(struct gve_priv *priv, struct gve_rx_ring *rx,
 			return NULL;
 		}
 		page_info->can_flip = recycle;
-		if (page_info->can_flip) {
-			u64_stats_update_begin(&rx->statss);
-			rx->rx_frag_flip_cnt++;
-			u64_stats_update_end(&rx->statss);
-		}
+		cnts->frag_flip_cnt += page_info->can_flip;
 
 		if (rx->data.raw_addressing) {
 			skb = gve_rx_raw_addressing(&priv->pdev->dev, netdev,
@@ -582,7 +654,8 @@ static struct sk_buff *gve_rx_skb(struct gve_priv *priv, struct gve_rx_ring *rx,
 						    rx->packet_buffer_size, ctx);
 		} else {
 			skb = gve_rx_qpl(&priv->pdev->dev, netdev, rx,
-					 page_info, len, napi, data_slot);
+					 page_info, len, napi, data_slot,
+					 is_only_frag, cnts);
 		}
 	}
 	return skb;
@@ -591,7 +664,8 @@ static struct sk_buff *gve_rx_skb(struct gve_priv *priv, struct gve_rx_ring *rx,
 static int gve_xsk_pool_redirect(struct net_device *dev,
 				 struct gve_rx_ring *rx,
 				 void *data, int len,
-				 struct bpf_prog *xdp_prog)
+				 struct bpf_prog *xdp_prog,
+				 struct gve_rx_cnts *cnts)
 {
 	struct xdp_buff *xdp;
 	int err;
@@ -600,9 +674,7 @@ static int gve_xsk_pool_redirect(struct net_device *dev,
 		return -E2BIG;
 	xdp = xsk_buff_alloc(rx->xsk_pool);
 	if (!xdp) {
-		u64_stats_update_begin(&rx->statss);
-		rx->xdp_alloc_fails++;
-		u64_stats_update_end(&rx->statss);
+		cnts->xdp_alloc_fails++;
 		return -ENOMEM;
 	}
 	xdp->data_end = xdp->data + len;
@@ -614,7 +686,8 @@ static int gve_xsk_pool_redirect(struct net_device *dev,
 }
 
 static int gve_xdp_redirect(struct net_device *dev, struct gve_rx_ring *rx,
-			    struct xdp_buff *orig, struct bpf_prog *xdp_prog)
+			    struct xdp_buff *orig, struct bpf_prog *xdp_prog,
+			    struct gve_rx_cnts *cnts)
 {
 	int total_len, len = orig->data_end - orig->data;
 	int headroom = XDP_PACKET_HEADROOM;
@@ -624,15 +697,13 @@ static int gve_xdp_redirect(struct net_device *dev, struct gve_rx_ring *rx,
 
 	if (rx->xsk_pool)
 		return gve_xsk_pool_redirect(dev, rx, orig->data,
-					     len, xdp_prog);
+					     len, xdp_prog, cnts);
 
 	total_len = headroom + SKB_DATA_ALIGN(len) +
 		SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
 	frame = page_frag_alloc(&rx->page_cache, total_len, GFP_ATOMIC);
 	if (!frame) {
-		u64_stats_update_begin(&rx->statss);
-		rx->xdp_alloc_fails++;
-		u64_stats_update_end(&rx->statss);
+		cnts->xdp_alloc_fails++;
 		return -ENOMEM;
 	}
 	xdp_init_buff(&new, total_len, &rx->xdp_rxq);
@@ -648,7 +719,7 @@ static int gve_xdp_redirect(struct net_device *dev, struct gve_rx_ring *rx,
 
 static void gve_xdp_done(struct gve_priv *priv, struct gve_rx_ring *rx,
 			 struct xdp_buff *xdp, struct bpf_prog *xprog,
-			 int xdp_act)
+			 int xdp_act, struct gve_rx_cnts *cnts)
 {
 	struct gve_tx_ring *tx;
 	int tx_qid;
@@ -667,26 +738,261 @@ static void gve_xdp_done(struct gve_priv *priv, struct gve_rx_ring *rx,
 				       xdp->data_end - xdp->data, NULL);
 		spin_unlock(&tx->xdp_lock);
 
-		if (unlikely(err)) {
-			u64_stats_update_begin(&rx->statss);
-			rx->xdp_tx_errors++;
-			u64_stats_update_end(&rx->statss);
-		}
+		if (unlikely(err))
+			cnts->xdp_tx_errors++;
 		break;
 	case XDP_REDIRECT:
-		err = gve_xdp_redirect(priv->dev, rx, xdp, xprog);
+		err = gve_xdp_redirect(priv->dev, rx, xdp, xprog, cnts);
 
-		if (unlikely(err)) {
-			u64_stats_update_begin(&rx->statss);
-			rx->xdp_redirect_errors++;
-			u64_stats_update_end(&rx->statss);
-		}
+		if (unlikely(err))
+			cnts->xdp_redirect_errors++;
 		break;
 	}
-	u64_stats_update_begin(&rx->statss);
 	if ((u32)xdp_act < GVE_XDP_ACTIONS)
-		rx->xdp_actions[xdp_act]++;
-	u64_stats_update_end(&rx->statss);
+		cnts->xdp_actions[xdp_act]++;
+}
+
+/* Headers of a TCP segment that software LRO may aggregate, parsed straight
+ * out of the receive buffer.
+ */
+struct gve_rx_lro_hdrs {
+	__be16 proto;
+	void *nh;
+	struct tcphdr *th;
+	u16 th_off; /* offset of the TCP header from the ethernet header */
+	u16 hdr_len;
+	u16 payload_len;
+};
+
+/* Returns true if the packet at va is a TCP segment carrying payload with
+ * no IP options, extension headers or fragmentation, only ACK and PSH set
+ * and a TCP checksum that is valid according to the device's partial sum.
+ */
+static bool gve_rx_lro_parse(void *va, u16 len, __sum16 csum,
+			     struct gve_rx_lro_hdrs *hdrs)
+{
+	__wsum sum = csum_unfold(csum);
+	struct ethhdr *eth = va;
+	struct tcphdr *th;
+	u16 l4_len;
+	u16 th_len;
+
+	if (len < ETH_HLEN)
+		return false;
+	len -= ETH_HLEN;
+
+	if (eth->h_proto == htons(ETH_P_IP)) {
+		struct iphdr *iph = va + ETH_HLEN;
+
+		if (len < sizeof(*iph) + sizeof(*th) || iph->ihl != 5 ||
+		    iph->protocol != IPPROTO_TCP ||
+		    ntohs(iph->tot_len) != len ||
+		    (iph->frag_off & htons(IP_MF | IP_OFFSET)) ||
+		    ip_fast_csum(iph, iph->ihl))
+			return false;
+
+		/* A valid IPv4 header sums to zero, so the partial sum over
+		 * L3+ bytes is the sum over the TCP segment alone.
+		 */
+		l4_len = len - sizeof(*iph);
+		if (csum_tcpudp_magic(iph->saddr, iph->daddr, l4_len,
+				      IPPROTO_TCP, sum))
+			return false;
+		hdrs->th_off = ETH_HLEN + sizeof(*iph);
+	} else if (eth->h_proto == htons(ETH_P_IPV6)) {
+		struct ipv6hdr *ip6h = va + ETH_HLEN;
+
+		if (len < sizeof(*ip6h) + sizeof(*th) ||
+		    ip6h->nexthdr != IPPROTO_TCP ||
+		    ntohs(ip6h->payload_len) != len - sizeof(*ip6h))
+			return false;
+
+		l4_len = len - sizeof(*ip6h);
+		sum = csum_sub(sum, csum_partial(ip6h, sizeof(*ip6h), 0));
+		if (csum_ipv6_magic(&ip6h->saddr, &ip6h->daddr, l4_len,
+				    IPPROTO_TCP, sum))
+			return false;
+		hdrs->th_off = ETH_HLEN + sizeof(*ip6h);
+	} else {
+		return false;
+	}
+
+	th = va + hdrs->th_off;
+	th_len = th->doff * 4;
+	if (th_len < sizeof(*th) || th_len >= l4_len)
+		return false;
+	if (!th->ack || (tcp_flag_word(th) & (TCP_FLAG_CWR | TCP_FLAG_ECE |
+					     TCP_FLAG_URG | TCP_FLAG_RST |
+					     TCP_FLAG_SYN | TCP_FLAG_FIN)))
+		return false;
+
+	hdrs->proto = eth->h_proto;
+	hdrs->nh = va + ETH_HLEN;
+	hdrs->th = th;
+	hdrs->hdr_len = hdrs->th_off + th_len;
+	hdrs->payload_len = l4_len - th_len;
+	return true;
+}
+
+/* Returns true if the segment continues the flow held in lro->skb in order
+ * and with identical headers apart from the IP length and TCP PSH flag.
+ */
+static bool gve_rx_lro_match(struct gve_rx_lro *lro,
+			     const struct gve_rx_lro_hdrs *hdrs)
+{
+	struct sk_buff *skb = lro->skb;
+	struct tcphdr *th = tcp_hdr(skb);
+
+	if (skb->protocol != hdrs->proto || lro->hdr_len != hdrs->hdr_len ||
+	    ntohl(hdrs->th->seq) != lro->next_seq ||
+	    hdrs->payload_len > lro->mss ||
+	    skb->len + hdrs->payload_len > U16_MAX ||
+	    skb_shinfo(skb)->nr_frags >= MAX_SKB_FRAGS)
+		return false;
+
+	if (hdrs->proto == htons(ETH_P_IP)) {
+		const struct iphdr *iph = ip_hdr(skb);
+		const struct iphdr *iph2 = hdrs->nh;
+
+		if (iph->saddr != iph2->saddr || iph->daddr != iph2->daddr ||
+		    iph->tos != iph2->tos || iph->ttl != iph2->ttl)
+			return false;
+	} else {
+		const struct ipv6hdr *ip6h = ipv6_hdr(skb);
+		const struct ipv6hdr *ip6h2 = hdrs->nh;
+
+		/* Compares version, traffic class and flow label at once. */
+		if (*(__be32 *)ip6h != *(__be32 *)ip6h2 ||
+		    ip6h->hop_limit != ip6h2->hop_limit ||
+		    !ipv6_addr_equal(&ip6h->saddr, &ip6h2->saddr) ||
+		    !ipv6_addr_equal(&ip6h->daddr, &ip6h2->daddr))
+			return false;
+	}
+
+	/* The flag word also covers the data offset and the window. */
+	return th->source == hdrs->th->source &&
+	       th->dest == hdrs->th->dest &&
+	       th->ack_seq == hdrs->th->ack_seq &&
+	       !((tcp_flag_word(th) ^ tcp_flag_word(hdrs->th)) &
+		 ~TCP_FLAG_PSH) &&
+	       !memcmp(th + 1, hdrs->th + 1, th->doff * 4 - sizeof(*th));
+}
+
+static void gve_rx_lro_flush(struct gve_rx_ring *rx, struct napi_struct *napi,
+			     struct gve_rx_cnts *cnts)
+{
+	struct gve_rx_lro *lro = &rx->lro;
+	struct sk_buff *skb = lro->skb;
+
+	if (!skb)
+		return;
+	lro->skb = NULL;
+
+	/* Aggregates must set gso_size otherwise the TCP stack will complain
+	 * that packets are larger than MTU.
+	 */
+	if (lro->segs > 1) {
+		struct skb_shared_info *shinfo = skb_shinfo(skb);
+
+		if (skb->protocol == htons(ETH_P_IP)) {
+			struct iphdr *iph = ip_hdr(skb);
+
+			iph->tot_len = htons(skb->len);
+			ip_send_check(iph);
+			shinfo->gso_type = SKB_GSO_TCPV4;
+		} else {
+			ipv6_hdr(skb)->payload_len =
+				htons(skb->len - sizeof(struct ipv6hdr));
+			shinfo->gso_type = SKB_GSO_TCPV6;
+		}
+		shinfo->gso_size = lro->mss;
+		shinfo->gso_segs = lro->segs;
+		cnts->lro_aggr_cnt++;
+	}
+
+	napi_gro_receive(napi, skb);
+}
+
+/* GQI has no hardware RSC, so merge in-order segments of a TCP flow within
+ * a poll into a single skb before handing it to the stack.
+ * Returns 0 if the packet was merged or started a new aggregate,
+ * -EOPNOTSUPP if it must take the regular receive path and -ENOMEM if it
+ * could not be received.
+ */
+static int gve_rx_lro(struct gve_rx_ring *rx, struct napi_struct *napi,
+		      struct gve_rx_slot_page_info *page_info,
+		      union gve_rx_data_slot *data_slot,
+		      struct gve_rx_desc *desc, u16 len,
+		      netdev_features_t feat, struct gve_rx_cnts *cnts)
+{
+	void *va = page_info->page_address + page_info->page_offset +
+		page_info->pad;
+	struct gve_rx_lro *lro = &rx->lro;
+	struct gve_rx_ctx *ctx = &rx->ctx;
+	struct gve_priv *priv = rx->gve;
+	struct gve_rx_lro_hdrs hdrs;
+	struct sk_buff *skb;
+	bool push;
+
+	if (!(feat & NETIF_F_RXCSUM) || !(desc->flags_seq & GVE_RXF_TCP) ||
+	    !desc->csum || !gve_rx_lro_parse(va, len, desc->csum, &hdrs)) {
+		gve_rx_lro_flush(rx, napi, cnts);
+		return -EOPNOTSUPP;
+	}
+	push = hdrs.th->psh;
+
+	if (lro->skb && !gve_rx_lro_match(lro, &hdrs))
+		gve_rx_lro_flush(rx, napi, cnts);
+
+	skb = lro->skb;
+	if (!skb) {
+		skb = napi_alloc_skb(napi, hdrs.hdr_len);
+		if (unlikely(!skb))
+			return -ENOMEM;
+
+		__skb_put(skb, hdrs.hdr_len);
+		skb_copy_to_linear_data_offset(skb, 0, va, hdrs.hdr_len);
+	}
+
+	/* Only the payload goes into the aggregate as a page fragment. */
+	ctx->skb_head = skb;
+	ctx->skb_tail = skb;
+	page_info->pad += hdrs.hdr_len;
+	if (unlikely(!gve_rx_skb(priv, rx, page_info, napi, hdrs.payload_len,
+				 data_slot, false, cnts))) {
+		if (!lro->skb)
+			gve_drop_skb(skb, rx->q_num, GVE_DROP_RX_NOMEM);
+		return -ENOMEM;
+	}
+
+	if (lro->skb) {
+		tcp_hdr(skb)->psh |= push;
+		lro->next_seq += hdrs.payload_len;
+		lro->segs++;
+		cnts->lro_merged_pkt_cnt++;
+	} else {
+		skb->protocol = eth_type_trans(skb, priv->dev);
+		skb_reset_network_header(skb);
+		skb_set_transport_header(skb, hdrs.th_off - ETH_HLEN);
+		skb->ip_summed = CHECKSUM_UNNECESSARY;
+		if (likely(feat & NETIF_F_RXHASH) &&
+		    gve_needs_rss(desc->flags_seq))
+			skb_set_hash(skb, be32_to_cpu(desc->rss_hash),
+				     gve_rss_type(desc->flags_seq));
+		skb_record_rx_queue(skb, rx->q_num);
+
+		lro->skb = skb;
+		lro->next_seq = ntohl(hdrs.th->seq) + hdrs.payload_len;
+		lro->mss = hdrs.payload_len;
+		lro->hdr_len = hdrs.hdr_len;
+		lro->segs = 1;
+	}
+
+	/* Nothing can follow a pushed or short segment in the same aggregate. */
+	if (push || hdrs.payload_len < lro->mss)
+		gve_rx_lro_flush(rx, napi, cnts);
+
+	return 0;
 }
 
 #define GVE_PKTCONT_BIT_IS_SET(x) (GVE_RXF_PKT_CONT & (x))
@@ -718,7 +1024,7 @@ static void gve_rx(struct gve_rx_ring *rx, netdev_features_t feat,
 	if (desc->flags_seq & GVE_RXF_ERR) {
 		ctx->drop_pkt = true;
 		cnts->desc_err_pkt_cnt++;
-		napi_free_frags(napi);
+		gve_drop_frags(napi, rx->q_num, GVE_DROP_RX_DESC_ERR);
 		goto finish_frag;
 	}
 
@@ -726,7 +1032,7 @@ static void gve_rx(struct gve_rx_ring *rx, netdev_features_t feat,
 		netdev_warn(priv->dev, "Unexpected frag size %d, can't exceed %d, scheduling reset",
 			    frag_size, rx->packet_buffer_size);
 		ctx->drop_pkt = true;
-		napi_free_frags(napi);
+		gve_drop_frags(napi, rx->q_num, GVE_DROP_RX_FRAG_SIZE);
 		gve_schedule_reset(rx->gve);
 		goto finish_frag;
 	}
@@ -761,7 +1067,7 @@ static void gve_rx(struct gve_rx_ring *rx, netdev_features_t feat,
 		old_data = xdp.data;
 		xdp_act = bpf_prog_run_xdp(xprog, &xdp);
 		if (xdp_act != XDP_PASS) {
-			gve_xdp_done(priv, rx, &xdp, xprog, xdp_act);
+			gve_xdp_done(priv, rx, &xdp, xprog, xdp_act, cnts);
 			ctx->total_size += frag_size;
 			goto finish_ok_pkt;
 		}
@@ -769,19 +1075,33 @@ static void gve_rx(struct gve_rx_ring *rx, netdev_features_t feat,
 		page_info->pad += xdp.data - old_data;
 		len = xdp.data_end - xdp.data;
 
-		u64_stats_update_begin(&rx->statss);
-		rx->xdp_actions[XDP_PASS]++;
-		u64_stats_update_end(&rx->statss);
+		cnts->xdp_actions[XDP_PASS]++;
+	}
+
+	if ((feat & NETIF_F_LRO) && is_only_frag && !xprog) {
+		int err = gve_rx_lro(rx, napi, page_info, data_slot, desc, len,
+				     feat, cnts);
+
+		if (!err) {
+			ctx->total_size += frag_size;
+			goto finish_ok_pkt;
+		}
+		if (err == -ENOMEM) {
+			cnts->skb_alloc_fail_cnt++;
+			ctx->drop_pkt = true;
+			goto finish_frag;
+		}
+	} else if (is_first_frag) {
+		/* Keep packets in order behind a held aggregate. */
+		gve_rx_lro_flush(rx, napi, cnts);
 	}
 
 	skb = gve_rx_skb(priv, rx, page_info, napi, len,
-			 data_slot, is_only_frag);
+			 data_slot, is_only_frag, cnts);
 	if (!skb) {
-		u64_stats_update_begin(&rx->statss);
-		rx->rx_skb_alloc_fail++;
-		u64_stats_update_end(&rx->statss);
+		cnts->skb_alloc_fail_cnt++;
 
-		napi_free_frags(napi);
+		gve_drop_frags(napi, rx->q_num, GVE_DROP_RX_NOMEM);
 		ctx->drop_pkt = true;
 		goto finish_frag;
 	}
@@ -819,6 +1139,7 @@ finish_ok_pkt:
 	cnts->ok_pkt_bytes += ctx->total_size;
 	cnts->ok_pkt_cnt++;
 finish_frag:
+	trace_gve_rx(rx, desc, is_last_frag);
 	ctx->frag_cnt++;
 	if (is_last_frag) {
 		cnts->total_pkt_cnt++;
@@ -900,8 +1221,6 @@ static bool gve_rx_refill_buffers(struct gve_priv *priv, struct gve_rx_ring *rx)
 static int gve_clean_rx_done(struct gve_rx_ring *rx, int budget,
 			     netdev_features_t feat)
 {
-	u64 xdp_redirects = rx->xdp_actions[XDP_REDIRECT];
-	u64 xdp_txs = rx->xdp_actions[XDP_TX];
 	struct gve_rx_ctx *ctx = &rx->ctx;
 	struct gve_priv *priv = rx->gve;
 	struct gve_rx_cnts cnts = {0};
@@ -926,11 +1245,13 @@ static int gve_clean_rx_done(struct gve_rx_ring *rx, int budget,
 		work_done++;
 	}
 
+	gve_rx_lro_flush(rx, &priv->ntfy_blocks[rx->ntfy_id].napi, &cnts);
+
 	// The device will only send whole packets.
 	if (unlikely(ctx->frag_cnt)) {
 		struct napi_struct *napi = &priv->ntfy_blocks[rx->ntfy_id].napi;
 
-		napi_free_frags(napi);
+		gve_drop_frags(napi, rx->q_num, GVE_DROP_RX_INCOMPLETE);
 		gve_rx_ctx_clear(&rx->ctx);
 		netdev_warn(priv->dev, "Unexpected seq number %d with incomplete packet, expected %d, scheduling reset",
 			    GVE_SEQNO(desc->flags_seq), rx->desc.seqno);
@@ -940,19 +1261,13 @@ static int gve_clean_rx_done(struct gve_rx_ring *rx, int budget,
 	if (!work_done && rx->fill_cnt - rx->cnt > rx->db_threshold)
 		return 0;
 
-	if (work_done) {
-		u64_stats_update_begin(&rx->statss);
-		rx->rpackets += cnts.ok_pkt_cnt;
-		rx->rbytes += cnts.ok_pkt_bytes;
-		rx->rx_cont_packet_cnt += cnts.cont_pkt_cnt;
-		rx->rx_desc_err_dropped_pkt += cnts.desc_err_pkt_cnt;
-		u64_stats_update_end(&rx->statss);
-	}
+	if (work_done)
+		gve_rx_update_stats(rx, &cnts);
 
-	if (xdp_txs != rx->xdp_actions[XDP_TX])
+	if (cnts.xdp_actions[XDP_TX])
 		gve_xdp_tx_flush(priv, rx->q_num);
 
-	if (xdp_redirects != rx->xdp_actions[XDP_REDIRECT])
+	if (cnts.xdp_actions[XDP_REDIRECT])
 		xdp_do_flush();
 
 	/* restock ring slots */
@@ -975,7 +1290,7 @@ static int gve_clean_rx_done(struct gve_rx_ring *rx, int budget,
 		}
 	}
 
-	gve_rx_write_doorbell(priv, rx);
+	gve_rx_maybe_write_doorbell(priv, rx);
 	return cnts.total_pkt_cnt;
 }
 
@@ -7,13 +7,16 @@
 #include "gve.h"
 #include "gve_dqo.h"
 #include "gve_adminq.h"
+#include "gve_trace.h"
 #include "gve_utils.h"
 #include <linux/ip.h>
 #include <linux/ipv6.h>
+#include <linux/log2.h>
 #include <linux/skbuff.h>
 #include <linux/slab.h>
 #include <net/ip6_checksum.h>
 #include <net/ipv6.h>
+#include <net/page_pool/helpers.h>
 #include <net/tcp.h>
 
 static int gve_buf_ref_cnt(struct gve_rx_buf_state_dqo *bs)
@@ -27,27 +30,37 @@ static void gve_free_page_dqo(struct gve_priv *priv,
 {
 	page_ref_sub(bs->page_info.page, bs->page_info.pagecnt_bias - 1);
 	if (free_page)
-		gve_free_page(&priv->pdev->dev, bs->page_info.page, bs->addr,
-			      DMA_FROM_DEVICE);
+		gve_free_pages(&priv->pdev->dev, bs->page_info.page, bs->addr,
+			       DMA_FROM_DEVICE, bs->page_order);
 	bs->page_info.page = NULL;
 }
 
+/* Gives up the page still held by a buffer state on ring reset or teardown. */
+static void gve_rx_free_buf_page(struct gve_rx_ring *rx,
+				 struct gve_rx_buf_state_dqo *bs)
+{
+	if (rx->dqo.page_pool) {
+		page_pool_put_full_page(rx->dqo.page_pool, bs->page_info.page,
+					false);
+		bs->page_info.page = NULL;
+		return;
+	}
+
+	/* Only free page for RDA. QPL pages are freed in gve_main. */
+	gve_free_page_dqo(rx->gve, bs, !rx->dqo.qpl);
+}
+
 static struct gve_rx_buf_state_dqo *gve_alloc_buf_state(struct gve_rx_ring *rx)
 {
+	struct gve_index_stack *stack = &rx->dqo.free_buf_states;
 	struct gve_rx_buf_state_dqo *buf_state;
-	s16 buffer_id;
 
-	buffer_id = rx->dqo.free_buf_states;
-	if (unlikely(buffer_id == -1))
+	if (unlikely(stack->top == 0))
 		return NULL;
 
-	buf_state = &rx->dqo.buf_states[buffer_id];
-
-	/* Remove buf_state from free list */
-	rx->dqo.free_buf_states = buf_state->next;
-
-	/* Point buf_state to itself to mark it as allocated */
-	buf_state->next = buffer_id;
+	stack->top--;
+	buf_state = &rx->dqo.buf_states[stack->ids[stack->top]];
+	buf_state->allocated = true;
 
 	return buf_state;
 }
@@ -55,60 +68,54 @@ static struct gve_rx_buf_state_dqo *gve_alloc_buf_state(struct gve_rx_ring *rx)
 static bool gve_buf_state_is_allocated(struct gve_rx_ring *rx,
 				       struct gve_rx_buf_state_dqo *buf_state)
 {
-	s16 buffer_id = buf_state - rx->dqo.buf_states;
-
-	return buf_state->next == buffer_id;
+	return buf_state->allocated;
 }
 
 static void gve_free_buf_state(struct gve_rx_ring *rx,
 			       struct gve_rx_buf_state_dqo *buf_state)
 {
-	s16 buffer_id = buf_state - rx->dqo.buf_states;
+	struct gve_index_stack *stack = &rx->dqo.free_buf_states;
 
-	buf_state->next = rx->dqo.free_buf_states;
-	rx->dqo.free_buf_states = buffer_id;
+	buf_state->allocated = false;
+	stack->ids[stack->top] = buf_state - rx->dqo.buf_states;
+	stack->top++;
+}
+
+static bool gve_index_ring_empty(const struct gve_index_ring *ring)
+{
+	return ring->head == ring->tail;
+}
+
+static u32 gve_index_ring_len(const struct gve_index_ring *ring)
+{
+	return ring->tail - ring->head;
 }
 
 static struct gve_rx_buf_state_dqo *
-gve_dequeue_buf_state(struct gve_rx_ring *rx, struct gve_index_list *list)
+gve_dequeue_buf_state(struct gve_rx_ring *rx, struct gve_index_ring *ring)
 {
 	struct gve_rx_buf_state_dqo *buf_state;
-	s16 buffer_id;
+	u16 buffer_id;
 
-	buffer_id = list->head;
-	if (unlikely(buffer_id == -1))
+	if (unlikely(gve_index_ring_empty(ring)))
 		return NULL;
 
-	buf_state = &rx->dqo.buf_states[buffer_id];
-
-	/* Remove buf_state from list */
-	list->head = buf_state->next;
-	if (buf_state->next == -1)
-		list->tail = -1;
+	buffer_id = ring->ids[ring->head & ring->mask];
+	ring->head++;
 
-	/* Point buf_state to itself to mark it as allocated */
-	buf_state->next = buffer_id;
+	buf_state = &rx->dqo.buf_states[buffer_id];
+	buf_state->allocated = true;
 
 	return buf_state;
 }
 
 static void gve_enqueue_buf_state(struct gve_rx_ring *rx,
-				  struct gve_index_list *list,
+				  struct gve_index_ring *ring,
 				  struct gve_rx_buf_state_dqo *buf_state)
 {
-	s16 buffer_id = buf_state - rx->dqo.buf_states;
-
-	buf_state->next = -1;
-
-	if (list->head == -1) {
-		list->head = buffer_id;
-		list->tail = buffer_id;
-	} else {
-		int tail = list->tail;
-
-		rx->dqo.buf_states[tail].next = buffer_id;
-		list->tail = buffer_id;
-	}
+	buf_state->allocated = false;
+	ring->ids[ring->tail & ring->mask] = buf_state - rx->dqo.buf_states;
+	ring->tail++;
 }
 
 static void gve_recycle_buf(struct gve_rx_ring *rx,
@@ -129,7 +136,7 @@ gve_get_recycled_buf_state(struct gve_rx_ring *rx)
 	if (likely(buf_state))
 		return buf_state;
 
-	if (unlikely(rx->dqo.used_buf_states.head == -1))
+	if (unlikely(gve_index_ring_empty(&rx->dqo.used_buf_states)))
 		return NULL;
 
 	/* Used buf states are only usable when ref count reaches 0, which means
@@ -139,10 +146,8 @@ gve_get_recycled_buf_state(struct gve_rx_ring *rx)
 	 */
 	for (i = 0; i < 5; i++) {
 		buf_state = gve_dequeue_buf_state(rx, &rx->dqo.used_buf_states);
-		if (gve_buf_ref_cnt(buf_state) == 0) {
-			rx->dqo.used_buf_states_cnt--;
+		if (gve_buf_ref_cnt(buf_state) == 0)
 			return buf_state;
-		}
 
 		gve_enqueue_buf_state(rx, &rx->dqo.used_buf_states, buf_state);
 	}
@@ -156,7 +161,7 @@ gve_get_recycled_buf_state(struct gve_rx_ring *rx)
 	/* If there are no free buf states discard an entry from
 	 * `used_buf_states` so it can be used.
 	 */
-	if (unlikely(rx->dqo.free_buf_states == -1)) {
+	if (unlikely(rx->dqo.free_buf_states.top == 0)) {
 		buf_state = gve_dequeue_buf_state(rx, &rx->dqo.used_buf_states);
 		if (gve_buf_ref_cnt(buf_state) == 0)
 			return buf_state;
@@ -168,21 +173,48 @@ gve_get_recycled_buf_state(struct gve_rx_ring *rx)
 	return NULL;
 }
 
+static int gve_alloc_from_page_pool(struct gve_rx_ring *rx,
+				    struct gve_rx_buf_state_dqo *buf_state)
+{
+	unsigned int size = rx->gve->data_buffer_size_dqo;
+	unsigned int offset;
+	struct page *page;
+
+	page = page_pool_dev_alloc(rx->dqo.page_pool, &offset, &size);
+	if (!page)
+		return -ENOMEM;
+
+	buf_state->page_info.page = page;
+	buf_state->page_info.page_offset = offset;
+	buf_state->page_info.page_address = page_address(page);
+	buf_state->addr = page_pool_get_dma_addr(page);
+
+	return 0;
+}
+
 static int gve_alloc_page_dqo(struct gve_rx_ring *rx,
 			      struct gve_rx_buf_state_dqo *buf_state)
 {
 	struct gve_priv *priv = rx->gve;
 	u32 idx;
 
+	if (rx->dqo.page_pool)
+		return gve_alloc_from_page_pool(rx, buf_state);
+
 	if (!rx->dqo.qpl) {
+		/* Buffers above PAGE_SIZE get a compound page each, so large
+		 * RSC packets need fewer frags.
+		 */
+		unsigned int order = get_order(priv->data_buffer_size_dqo);
 		int err;
 
-		err = gve_alloc_page(priv, &priv->pdev->dev,
-				     &buf_state->page_info.page,
-				     &buf_state->addr,
-				     DMA_FROM_DEVICE, GFP_ATOMIC);
+		err = gve_alloc_pages(priv, &priv->pdev->dev,
+				      &buf_state->page_info.page,
+				      &buf_state->addr,
+				      DMA_FROM_DEVICE, GFP_ATOMIC, order);
 		if (err)
 			return err;
+		buf_state->page_order = order;
 	} else {
 		idx = rx->dqo.next_qpl_page_idx;
 		if (idx >= priv->rx_pages_per_qpl) {
@@ -206,21 +238,95 @@ static int gve_alloc_page_dqo(struct gve_rx_ring *rx,
 	return 0;
 }
 
+static int gve_alloc_hdr_page(struct gve_priv *priv,
+			      struct gve_header_page *hdr_page, gfp_t gfp_flags)
+{
+	int err;
+
+	err = gve_alloc_page(priv, &priv->pdev->dev, &hdr_page->page_info.page,
+			     &hdr_page->addr, DMA_FROM_DEVICE, gfp_flags);
+	if (err)
+		return err;
+
+	hdr_page->page_info.page_offset = 0;
+	hdr_page->page_info.page_address =
+		page_address(hdr_page->page_info.page);
+
+	/* The page already has 1 ref. */
+	page_ref_add(hdr_page->page_info.page, INT_MAX - 1);
+	hdr_page->page_info.pagecnt_bias = INT_MAX;
+
+	return 0;
+}
+
+static void gve_free_hdr_page(struct gve_priv *priv,
+			      struct gve_header_page *hdr_page)
+{
+	page_ref_sub(hdr_page->page_info.page,
+		     hdr_page->page_info.pagecnt_bias - 1);
+	gve_free_page(&priv->pdev->dev, hdr_page->page_info.page,
+		      hdr_page->addr, DMA_FROM_DEVICE);
+	hdr_page->page_info.page = NULL;
+}
+
 static void gve_rx_free_hdr_bufs(struct gve_priv *priv, int idx)
 {
 	struct gve_rx_ring *rx = &priv->rx[idx];
-	int buffer_queue_slots = rx->dqo.bufq.mask + 1;
 	int i;
 
-	if (rx->dqo.hdr_bufs) {
-		for (i = 0; i < buffer_queue_slots; i++)
-			if (rx->dqo.hdr_bufs[i].data)
-				dma_pool_free(priv->header_buf_pool,
-					      rx->dqo.hdr_bufs[i].data,
-					      rx->dqo.hdr_bufs[i].addr);
-		kvfree(rx->dqo.hdr_bufs);
-		rx->dqo.hdr_bufs = NULL;
+	if (rx->dqo.hdr_pages) {
+		for (i = 0; i < rx->dqo.num_hdr_pages; i++)
+			if (rx->dqo.hdr_pages[i].page_info.page)
+				gve_free_hdr_page(priv, &rx->dqo.hdr_pages[i]);
+		kvfree(rx->dqo.hdr_pages);
+		rx->dqo.hdr_pages = NULL;
 	}
+
+	kvfree(rx->dqo.hdr_bufs);
+	rx->dqo.hdr_bufs = NULL;
+}
+
+/* Hands out the next header buffer, moving on to the next header page once
+ * the current one is used up. The pages hold twice as many header buffers
+ * as there are buffer queue slots and they are handed out in order, so none
+ * of a page's buffers are still posted by the time the page comes around
+ * again.
+ */
+static int gve_get_hdr_buf(struct gve_rx_ring *rx,
+			   struct gve_header_buf *hdr_buf)
+{
+	struct gve_header_page *hdr_page;
+	struct gve_priv *priv = rx->gve;
+	u32 offset;
+
+	hdr_page = &rx->dqo.hdr_pages[rx->dqo.hdr_page_idx];
+	if (hdr_page->page_info.page_offset + priv->header_buf_truesize >
+	    PAGE_SIZE) {
+		if (++rx->dqo.hdr_page_idx == rx->dqo.num_hdr_pages)
+			rx->dqo.hdr_page_idx = 0;
+		hdr_page = &rx->dqo.hdr_pages[rx->dqo.hdr_page_idx];
+
+		/* If the stack is still holding on to headers from this
+		 * page, leave the page to it and carry on with a new one.
+		 */
+		if (hdr_page->page_info.page &&
+		    page_count(hdr_page->page_info.page) !=
+		    hdr_page->page_info.pagecnt_bias)
+			gve_free_hdr_page(priv, hdr_page);
+		hdr_page->page_info.page_offset = 0;
+	}
+
+	if (unlikely(!hdr_page->page_info.page) &&
+	    gve_alloc_hdr_page(priv, hdr_page, GFP_ATOMIC))
+		return -ENOMEM;
+
+	offset = hdr_page->page_info.page_offset + GVE_RX_HDR_HEADROOM;
+	hdr_buf->hdr_page = hdr_page;
+	hdr_buf->data = hdr_page->page_info.page_address + offset;
+	hdr_buf->addr = hdr_page->addr + offset;
+	hdr_page->page_info.page_offset += priv->header_buf_truesize;
+
+	return 0;
 }
 
 static void gve_rx_free_ring_dqo(struct gve_priv *priv, int idx)
@@ -245,9 +351,13 @@ static void gve_rx_free_ring_dqo(struct gve_priv *priv, int idx)
 
 	for (i = 0; i < rx->dqo.num_buf_states; i++) {
 		struct gve_rx_buf_state_dqo *bs = &rx->dqo.buf_states[i];
-		/* Only free page for RDA. QPL pages are freed in gve_main. */
+
 		if (bs->page_info.page)
-			gve_free_page_dqo(priv, bs, !rx->dqo.qpl);
+			gve_rx_free_buf_page(rx, bs);
+	}
+	if (rx->dqo.page_pool) {
+		page_pool_destroy(rx->dqo.page_pool);
+		rx->dqo.page_pool = NULL;
 	}
 	if (rx->dqo.qpl) {
 		gve_unassign_qpl(priv, rx->dqo.qpl->id);
@@ -271,6 +381,12 @@ static void gve_rx_free_ring_dqo(struct gve_priv *priv, int idx)
 
 	kvfree(rx->dqo.buf_states);
 	rx->dqo.buf_states = NULL;
+	kvfree(rx->dqo.free_buf_states.ids);
+	rx->dqo.free_buf_states.ids = NULL;
+	kvfree(rx->dqo.recycled_buf_states.ids);
+	rx->dqo.recycled_buf_states.ids = NULL;
+	kvfree(rx->dqo.used_buf_states.ids);
+	rx->dqo.used_buf_states.ids = NULL;
 
 	gve_rx_free_hdr_bufs(priv, idx);
 
@@ -281,22 +397,29 @@ static int gve_rx_alloc_hdr_bufs(struct gve_priv *priv, int idx)
 {
 	struct gve_rx_ring *rx = &priv->rx[idx];
 	int buffer_queue_slots = rx->dqo.bufq.mask + 1;
+	int bufs_per_page = PAGE_SIZE / priv->header_buf_truesize;
 	int i;
 
-	rx->dqo.hdr_bufs = kvcalloc(buffer_queue_slots,
+	/* One per buffer state, indexed by buffer id */
+	rx->dqo.hdr_bufs = kvcalloc(rx->dqo.num_buf_states,
 				    sizeof(rx->dqo.hdr_bufs[0]),
 				    GFP_KERNEL);
 	if (!rx->dqo.hdr_bufs)
 		return -ENOMEM;
 
-	for (i = 0; i < buffer_queue_slots; i++) {
-		rx->dqo.hdr_bufs[i].data =
-			dma_pool_alloc(priv->header_buf_pool,
-				       GFP_KERNEL,
-				       &rx->dqo.hdr_bufs[i].addr);
-		if (!rx->dqo.hdr_bufs[i].data)
+	rx->dqo.num_hdr_pages = DIV_ROUND_UP(2 * buffer_queue_slots,
+					     bufs_per_page);
+	rx->dqo.hdr_pages = kvcalloc(rx->dqo.num_hdr_pages,
+				     sizeof(rx->dqo.hdr_pages[0]),
+				     GFP_KERNEL);
+	if (!rx->dqo.hdr_pages)
+		goto err;
+
+	for (i = 0; i < rx->dqo.num_hdr_pages; i++)
+		if (gve_alloc_hdr_page(priv, &rx->dqo.hdr_pages[i],
+				       GFP_KERNEL))
 			goto err;
-	}
+	rx->dqo.hdr_page_idx = 0;
 
 	return 0;
 err:
@@ -304,6 +427,45 @@ err:
 	return -ENOMEM;
 }
 
+/* The pool holds a page for every buffer state, and it recycles pages for
+ * the ring when the stack frees skbs built on them.
+ */
+static int gve_rx_create_page_pool(struct gve_priv *priv,
+				   struct gve_rx_ring *rx)
+{
+	unsigned int order = get_order(priv->data_buffer_size_dqo);
+	struct page_pool_params pp = {
+		.flags = PP_FLAG_DMA_MAP | PP_FLAG_DMA_SYNC_DEV,
+		.order = order,
+		.pool_size = rx->dqo.num_buf_states,
+		.nid = NUMA_NO_NODE,
+		.dev = &priv->pdev->dev,
+		.netdev = priv->dev,
+		.dma_dir = DMA_FROM_DEVICE,
+		.max_len = PAGE_SIZE << order,
+	};
+	struct page_pool *pool;
+
+	pool = page_pool_create(&pp);
+	if (IS_ERR(pool))
+		return PTR_ERR(pool);
+
+	rx->dqo.page_pool = pool;
+	return 0;
+}
+
+static int gve_alloc_index_ring(struct gve_index_ring *ring, u32 size)
+{
+	size = roundup_pow_of_two(size);
+
+	ring->ids = kvcalloc(size, sizeof(ring->ids[0]), GFP_KERNEL);
+	if (!ring->ids)
+		return -ENOMEM;
+	ring->mask = size - 1;
+
+	return 0;
+}
+
 static void gve_rx_init_ring_state_dqo(struct gve_rx_ring *rx,
 				       const u32 buffer_queue_slots,
 				       const u32 completion_queue_slots)
@@ -325,16 +487,17 @@ static void gve_rx_init_ring_state_dqo(struct gve_rx_ring *rx,
 	rx->ctx.skb_head = NULL;
 	rx->ctx.skb_tail = NULL;
 
-	/* Set up linked list of buffer IDs */
-	for (i = 0; i < rx->dqo.num_buf_states - 1; i++)
-		rx->dqo.buf_states[i].next = i + 1;
-	rx->dqo.buf_states[rx->dqo.num_buf_states - 1].next = -1;
+	/* Push buffer IDs so that the lowest ID is popped first */
+	for (i = 0; i < rx->dqo.num_buf_states; i++) {
+		rx->dqo.buf_states[i].allocated = false;
+		rx->dqo.free_buf_states.ids[i] = rx->dqo.num_buf_states - 1 - i;
+	}
+	rx->dqo.free_buf_states.top = rx->dqo.num_buf_states;
 
-	rx->dqo.free_buf_states = 0;
-	rx->dqo.recycled_buf_states.head = -1;
-	rx->dqo.recycled_buf_states.tail = -1;
-	rx->dqo.used_buf_states.head = -1;
-	rx->dqo.used_buf_states.tail = -1;
+	rx->dqo.recycled_buf_states.head = 0;
+	rx->dqo.recycled_buf_states.tail = 0;
+	rx->dqo.used_buf_states.head = 0;
+	rx->dqo.used_buf_states.tail = 0;
 }
 
 static void gve_rx_reset_ring_dqo(struct gve_priv *priv, int idx)
@@ -366,7 +529,7 @@ static void gve_rx_reset_ring_dqo(struct gve_priv *priv, int idx)
 		struct gve_rx_buf_state_dqo *bs = &rx->dqo.buf_states[i];
 
 		if (bs->page_info.page)
-			gve_free_page_dqo(priv, bs, !rx->dqo.qpl);
+			gve_rx_free_buf_page(rx, bs);
 	}
 
 	gve_rx_init_ring_state_dqo(rx, buffer_queue_slots,
@@ -399,6 +562,23 @@ static int gve_rx_alloc_ring_dqo(struct gve_priv *priv, int idx)
 	if (!rx->dqo.buf_states)
 		return -ENOMEM;
 
+	/* Allocate index arrays. Every buf_state is on at most one of them, so
+	 * each needs room for all of the buf_states.
+	 */
+	rx->dqo.free_buf_states.ids =
+		kvcalloc(rx->dqo.num_buf_states,
+			 sizeof(rx->dqo.free_buf_states.ids[0]), GFP_KERNEL);
+	if (!rx->dqo.free_buf_states.ids)
+		goto err;
+
+	if (gve_alloc_index_ring(&rx->dqo.recycled_buf_states,
+				 rx->dqo.num_buf_states))
+		goto err;
+
+	if (gve_alloc_index_ring(&rx->dqo.used_buf_states,
+				 rx->dqo.num_buf_states))
+		goto err;
+
 	/* Allocate RX completion queue */
 	size = sizeof(rx->dqo.complq.desc_ring[0]) *
 		completion_queue_slots;
@@ -414,6 +594,10 @@ static int gve_rx_alloc_ring_dqo(struct gve_priv *priv, int idx)
 	if (!rx->dqo.bufq.desc_ring)
 		goto err;
 
+	if (priv->queue_format == GVE_DQO_RDA_FORMAT &&
+	    gve_rx_create_page_pool(priv, rx))
+		goto err;
+
 	if (priv->queue_format != GVE_DQO_RDA_FORMAT) {
 		rx->dqo.qpl = gve_assign_rx_qpl(priv, rx->q_num);
 		if (!rx->dqo.qpl)
@@ -430,7 +614,7 @@ static int gve_rx_alloc_ring_dqo(struct gve_priv *priv, int idx)
 				   completion_queue_slots);
 
 	/* Allocate header buffers for header-split */
-	if (priv->header_buf_pool)
+	if (priv->header_buf_truesize)
 		if (gve_rx_alloc_hdr_bufs(priv, idx))
 			goto err;
 
@@ -443,24 +627,27 @@ err:
 	return -ENOMEM;
 }
 
-void gve_rx_write_doorbell_dqo(const struct gve_priv *priv, int queue_idx)
+void gve_rx_write_doorbell_dqo(const struct gve_priv *priv,
+			       struct gve_rx_ring *rx)
 {
-	const struct gve_rx_ring *rx = &priv->rx[queue_idx];
 	u64 index = be32_to_cpu(rx->q_resources->db_index);
 
+	trace_gve_doorbell(GVE_TRACE_DB_RX, rx->q_num, rx->dqo.bufq.tail);
 	iowrite32(rx->dqo.bufq.tail, &priv->db_bar2[index]);
+	u64_stats_update_begin(&rx->statss);
+	rx->doorbell_cnt++;
+	u64_stats_update_end(&rx->statss);
 }
 
-static int gve_rx_alloc_hdr_buf_pool(struct gve_priv *priv)
+/* Header buffers are laid out so that an skb can be built around them:
+ * headroom, the header written by the device and the skb_shared_info.
+ */
+static void gve_rx_init_hdr_buf_truesize(struct gve_priv *priv)
 {
-	priv->header_buf_pool = dma_pool_create("header_bufs",
-						&priv->pdev->dev,
-						priv->header_buf_size,
-						64, 0);
-	if (!priv->header_buf_pool)
-		return -ENOMEM;
-
-	return 0;
+	priv->header_buf_truesize =
+		roundup_pow_of_two(SKB_DATA_ALIGN(GVE_RX_HDR_HEADROOM +
+						  priv->header_buf_size) +
+				   SKB_DATA_ALIGN(sizeof(struct skb_shared_info)));
 }
 
 int gve_rx_alloc_rings_dqo(struct gve_priv *priv)
@@ -468,11 +655,8 @@ int gve_rx_alloc_rings_dqo(struct gve_priv *priv)
 	int err = 0;
 	int i = 0;
 
-	if (gve_get_enable_header_split(priv)) {
-		err = gve_rx_alloc_hdr_buf_pool(priv);
-		if (err)
-			goto err;
-	}
+	if (gve_get_enable_header_split(priv))
+		gve_rx_init_hdr_buf_truesize(priv);
 
 	for (i = 0; i < priv->rx_cfg.num_queues; i++) {
 		err = gve_rx_alloc_ring_dqo(priv, i);
@@ -508,8 +692,7 @@ void gve_rx_free_rings_dqo(struct gve_priv *priv)
 	for (i = 0; i < priv->rx_cfg.num_queues; i++)
 		gve_rx_free_ring_dqo(priv, i);
 
-	dma_pool_destroy(priv->header_buf_pool);
-	priv->header_buf_pool = NULL;
+	priv->header_buf_truesize = 0;
 }
 
 void gve_rx_post_buffers_dqo(struct gve_rx_ring *rx)
@@ -520,14 +703,17 @@ void gve_rx_post_buffers_dqo(struct gve_rx_ring *rx)
 	u32 num_avail_slots;
 	u32 num_full_slots;
 	u32 num_posted = 0;
+	u32 db_batch;
 
 	num_full_slots = (bufq->tail - bufq->head) & bufq->mask;
 	num_avail_slots = bufq->mask - num_full_slots;
 
 	num_avail_slots = min_t(u32, num_avail_slots, complq->num_free_slots);
+	db_batch = gve_rx_db_batch(priv, bufq->mask + 1);
 	while (num_posted < num_avail_slots) {
 		struct gve_rx_desc_dqo *desc = &bufq->desc_ring[bufq->tail];
 		struct gve_rx_buf_state_dqo *buf_state;
+		u16 buf_id;
 
 		buf_state = gve_get_recycled_buf_state(rx);
 		if (unlikely(!buf_state)) {
@@ -544,22 +730,36 @@ void gve_rx_post_buffers_dqo(struct gve_rx_ring *rx)
 			}
 		}
 
-		desc->buf_id = cpu_to_le16(buf_state - rx->dqo.buf_states);
-		desc->buf_addr = cpu_to_le64(buf_state->addr +
-					     buf_state->page_info.page_offset);
+		buf_id = buf_state - rx->dqo.buf_states;
 		if (rx->dqo.hdr_bufs) {
+			/* Keyed by buffer id, since completions may return
+			 * buffers out of order and the previous user of this
+			 * bufq slot can still be with the device.
+			 */
 			struct gve_header_buf *hdr_buf =
-				&rx->dqo.hdr_bufs[bufq->tail];
+				&rx->dqo.hdr_bufs[buf_id];
+
+			if (unlikely(gve_get_hdr_buf(rx, hdr_buf))) {
+				u64_stats_update_begin(&rx->statss);
+				rx->rx_buf_alloc_fail++;
+				u64_stats_update_end(&rx->statss);
+				gve_recycle_buf(rx, buf_state);
+				break;
+			}
 			buf_state->hdr_buf = hdr_buf;
 			desc->header_buf_addr = cpu_to_le64(hdr_buf->addr);
 		}
 
+		desc->buf_id = cpu_to_le16(buf_id);
+		desc->buf_addr = cpu_to_le64(buf_state->addr +
+					     buf_state->page_info.page_offset);
+
 		bufq->tail = (bufq->tail + 1) & bufq->mask;
 		complq->num_free_slots--;
 		num_posted++;
 
-		if ((bufq->tail & (GVE_RX_BUF_THRESH_DQO - 1)) == 0)
-			gve_rx_write_doorbell_dqo(priv, rx->q_num);
+		if ((bufq->tail & (db_batch - 1)) == 0)
+			gve_rx_write_doorbell_dqo(priv, rx);
 	}
 
 	rx->fill_cnt += num_posted;
@@ -604,7 +804,6 @@ static void gve_try_recycle_buf(struct gve_priv *priv, struct gve_rx_ring *rx,
 
 mark_used:
 	gve_enqueue_buf_state(rx, &rx->dqo.used_buf_states, buf_state);
-	rx->dqo.used_buf_states_cnt++;
 }
 
 static void gve_rx_skb_csum(struct sk_buff *skb,
@@ -655,12 +854,10 @@ static void gve_rx_skb_hash(struct sk_buff *skb,
 	skb_set_hash(skb, le32_to_cpu(compl_desc->hash), hash_type);
 }
 
-static void gve_rx_free_skb(struct gve_rx_ring *rx)
+static void gve_rx_free_skb(struct gve_rx_ring *rx,
+			    enum gve_drop_reason reason)
 {
-	if (!rx->ctx.skb_head)
-		return;
-
-	dev_kfree_skb_any(rx->ctx.skb_head);
+	gve_drop_skb(rx->ctx.skb_head, rx->q_num, reason);
 	rx->ctx.skb_head = NULL;
 	rx->ctx.skb_tail = NULL;
 }
@@ -669,7 +866,7 @@ static bool gve_rx_should_trigger_copy_ondemand(struct gve_rx_ring *rx)
 {
 	if (!rx->dqo.qpl)
 		return false;
-	if (rx->dqo.used_buf_states_cnt <
+	if (gve_index_ring_len(&rx->dqo.used_buf_states) <
 		     (rx->dqo.num_buf_states -
 		     GVE_DQO_QPL_ONDEMAND_ALLOC_THRESHOLD))
 		return false;
@@ -678,7 +875,7 @@ static bool gve_rx_should_trigger_copy_ondemand(struct gve_rx_ring *rx)
 
 static int gve_rx_copy_ondemand(struct gve_rx_ring *rx,
 				struct gve_rx_buf_state_dqo *buf_state,
-				u16 buf_len)
+				u16 buf_len, struct gve_rx_cnts *cnts)
 {
 	struct page *page = alloc_page(GFP_ATOMIC);
 	int num_frags;
@@ -694,20 +891,83 @@ static int gve_rx_copy_ondemand(struct gve_rx_ring *rx,
 	skb_add_rx_frag(rx->ctx.skb_tail, num_frags, page,
 			0, buf_len, PAGE_SIZE);
 
-	u64_stats_update_begin(&rx->statss);
-	rx->rx_frag_alloc_cnt++;
-	u64_stats_update_end(&rx->statss);
+	cnts->frag_alloc_cnt++;
 	gve_recycle_buf(rx, buf_state);
 	return 0;
 }
 
+/* Attaches a data buffer to the skb as frag num_frags, handing one of the
+ * page's references over to the skb.
+ */
+static void gve_rx_skb_add_buf(struct gve_rx_ring *rx, struct sk_buff *skb,
+			       int num_frags,
+			       struct gve_rx_buf_state_dqo *buf_state,
+			       u16 buf_len)
+{
+	struct gve_priv *priv = rx->gve;
+
+	skb_add_rx_frag(skb, num_frags, buf_state->page_info.page,
+			buf_state->page_info.page_offset, buf_len,
+			priv->data_buffer_size_dqo);
+
+	/* The skb owns the buffer now and hands it back to the pool */
+	if (rx->dqo.page_pool) {
+		skb_mark_for_recycle(skb);
+		buf_state->page_info.page = NULL;
+		gve_free_buf_state(rx, buf_state);
+		return;
+	}
+
+	gve_dec_pagecnt_bias(&buf_state->page_info);
+
+	/* Advances buffer page-offset if page is partially used.
+	 * Marks buffer as used if page is full.
+	 */
+	gve_try_recycle_buf(priv, rx, buf_state);
+}
+
+/* Builds an skb around a header buffer rather than copying the header out
+ * of it. The skb takes one of the header page's references with it, which
+ * keeps the page from being reused until the skb is freed.
+ */
+static struct sk_buff *gve_rx_build_hdr_skb(struct gve_rx_ring *rx,
+					    struct napi_struct *napi,
+					    struct gve_header_buf *hdr_buf,
+					    u16 hdr_len)
+{
+	struct gve_header_page *hdr_page = hdr_buf->hdr_page;
+	struct gve_priv *priv = rx->gve;
+	struct sk_buff *skb;
+
+	dma_sync_single_range_for_cpu(&priv->pdev->dev, hdr_page->addr,
+				      hdr_buf->data -
+				      hdr_page->page_info.page_address,
+				      hdr_len, DMA_FROM_DEVICE);
+
+	skb = napi_build_skb(hdr_buf->data - GVE_RX_HDR_HEADROOM,
+			     priv->header_buf_truesize);
+	if (unlikely(!skb))
+		return NULL;
+
+	skb_reserve(skb, GVE_RX_HDR_HEADROOM);
+	__skb_put(skb, hdr_len);
+	skb->protocol = eth_type_trans(skb, priv->dev);
+	gve_dec_pagecnt_bias(&hdr_page->page_info);
+
+	return skb;
+}
+
 /* Chains multi skbs for single rx packet.
  * Returns 0 if buffer is appended, -1 otherwise.
+ *
+ * GRO never merges an skb that carries a frag_list, so an RSC packet that
+ * overflows MAX_SKB_FRAGS is delivered as is, even with gro_max_size raised
+ * above 64K. Buffers of 4K and up keep a 64K RSC packet within the frags.
  */
 static int gve_rx_append_frags(struct napi_struct *napi,
 			       struct gve_rx_buf_state_dqo *buf_state,
 			       u16 buf_len, struct gve_rx_ring *rx,
-			       struct gve_priv *priv)
+			       struct gve_priv *priv, struct gve_rx_cnts *cnts)
 {
 	int num_frags = skb_shinfo(rx->ctx.skb_tail)->nr_frags;
 
@@ -730,18 +990,10 @@ static int gve_rx_append_frags(struct napi_struct *napi,
 
 	/* Trigger ondemand page allocation if we are running low on buffers */
 	if (gve_rx_should_trigger_copy_ondemand(rx))
-		return gve_rx_copy_ondemand(rx, buf_state, buf_len);
-
-	skb_add_rx_frag(rx->ctx.skb_tail, num_frags,
-			buf_state->page_info.page,
-			buf_state->page_info.page_offset,
-			buf_len, priv->data_buffer_size_dqo);
-	gve_dec_pagecnt_bias(&buf_state->page_info);
+		return gve_rx_copy_ondemand(rx, buf_state, buf_len, cnts);
 
-	/* Advances buffer page-offset if page is partially used.
-	 * Marks buffer as used if page is full.
-	 */
-	gve_try_recycle_buf(priv, rx, buf_state);
+	gve_rx_skb_add_buf(rx, rx->ctx.skb_tail, num_frags, buf_state,
+			   buf_len);
 	return 0;
 }
 
@@ -751,7 +1003,7 @@ static int gve_rx_append_frags(struct napi_struct *napi,
  */
 static int gve_rx_dqo(struct napi_struct *napi, struct gve_rx_ring *rx,
 		      const struct gve_rx_compl_desc_dqo *compl_desc,
-		      int queue_idx)
+		      int queue_idx, struct gve_rx_cnts *cnts)
 {
 	const u16 buffer_id = le16_to_cpu(compl_desc->buf_id);
 	const bool hbo = compl_desc->header_buffer_overflow != 0;
@@ -759,6 +1011,7 @@ static int gve_rx_dqo(struct napi_struct *napi, struct gve_rx_ring *rx,
 	const bool sph = compl_desc->split_header != 0;
 	struct gve_rx_buf_state_dqo *buf_state;
 	struct gve_priv *priv = rx->gve;
+	bool page_aligned;
 	u16 buf_len;
 	u16 hdr_len;
 
@@ -789,6 +1042,12 @@ static int gve_rx_dqo(struct napi_struct *napi, struct gve_rx_ring *rx,
 		return -EINVAL;
 	}
 
+	/* A split header skb is built around a fixed size header slot. */
+	if (unlikely(sph && hdr_len > priv->header_buf_size)) {
+		gve_recycle_buf(rx, buf_state);
+		return -EFAULT;
+	}
+
 	if (unlikely(hdr_len && buf_state->hdr_buf == NULL)) {
 		gve_recycle_buf(rx, buf_state);
 		return -EINVAL;
@@ -804,25 +1063,19 @@ static int gve_rx_dqo(struct napi_struct *napi, struct gve_rx_ring *rx,
 	 */
 	prefetch(buf_state->page_info.page);
 
-	/* Copy the header into the skb in the case of header split */
+	/* Build the skb around the header buffer in the case of header split */
 	if (sph) {
-		dma_sync_single_for_cpu(&priv->pdev->dev,
-					buf_state->hdr_buf->addr,
-					hdr_len, DMA_FROM_DEVICE);
-
-		rx->ctx.skb_head = gve_rx_copy_data(priv->dev, napi,
-						    buf_state->hdr_buf->data,
-						    hdr_len);
+		rx->ctx.skb_head = gve_rx_build_hdr_skb(rx, napi,
+							buf_state->hdr_buf,
+							hdr_len);
 		if (unlikely(!rx->ctx.skb_head))
 			goto error;
 
 		rx->ctx.skb_tail = rx->ctx.skb_head;
 
-		u64_stats_update_begin(&rx->statss);
-		rx->rx_hsplit_pkt++;
-		rx->rx_hsplit_hbo_pkt += hbo;
-		rx->rheader_bytes += hdr_len;
-		u64_stats_update_end(&rx->statss);
+		cnts->hsplit_pkt_cnt++;
+		cnts->hsplit_hbo_pkt_cnt += hbo;
+		cnts->header_bytes += hdr_len;
 	}
 
 	/* Sync the portion of dma buffer for CPU to read. */
@@ -832,9 +1085,17 @@ static int gve_rx_dqo(struct napi_struct *napi, struct gve_rx_ring *rx,
 
 	/* Append to current skb if one exists. */
 	if (rx->ctx.skb_head) {
+		/* A payload that fills whole pages from their start is what
+		 * TCP zerocopy receive can map.
+		 */
+		page_aligned = sph && buf_len &&
+			priv->data_buffer_size_dqo == PAGE_SIZE &&
+			!buf_state->page_info.page_offset;
+
 		if (unlikely(gve_rx_append_frags(napi, buf_state, buf_len, rx,
-						 priv)) != 0)
+						 priv, cnts)) != 0)
 			goto error;
+		cnts->page_aligned_pkt_cnt += page_aligned;
 		return 0;
 	}
 
@@ -845,10 +1106,8 @@ static int gve_rx_dqo(struct napi_struct *napi, struct gve_rx_ring *rx,
 			goto error;
 		rx->ctx.skb_tail = rx->ctx.skb_head;
 
-		u64_stats_update_begin(&rx->statss);
-		rx->rx_copied_pkt++;
-		rx->rx_copybreak_pkt++;
-		u64_stats_update_end(&rx->statss);
+		cnts->copied_pkt_cnt++;
+		cnts->copybreak_pkt_cnt++;
 
 		gve_recycle_buf(rx, buf_state);
 		return 0;
@@ -860,17 +1119,12 @@ static int gve_rx_dqo(struct napi_struct *napi, struct gve_rx_ring *rx,
 	rx->ctx.skb_tail = rx->ctx.skb_head;
 
 	if (gve_rx_should_trigger_copy_ondemand(rx)) {
-		if (gve_rx_copy_ondemand(rx, buf_state, buf_len) < 0)
+		if (gve_rx_copy_ondemand(rx, buf_state, buf_len, cnts) < 0)
 			goto error;
 		return 0;
 	}
 
-	skb_add_rx_frag(rx->ctx.skb_head, 0, buf_state->page_info.page,
-			buf_state->page_info.page_offset, buf_len,
-			priv->data_buffer_size_dqo);
-	gve_dec_pagecnt_bias(&buf_state->page_info);
-
-	gve_try_recycle_buf(priv, rx, buf_state);
+	gve_rx_skb_add_buf(rx, rx->ctx.skb_head, 0, buf_state, buf_len);
 	return 0;
 
 error:
@@ -885,6 +1139,7 @@ static int gve_rx_complete_rsc(struct sk_buff *skb,
 			       struct gve_ptype ptype)
 {
 	struct skb_shared_info *shinfo = skb_shinfo(skb);
+	u32 payload_len;
 
 	/* Only TCP is supported right now. */
 	if (ptype.l4_type != GVE_L4_TYPE_TCP)
@@ -902,13 +1157,31 @@ static int gve_rx_complete_rsc(struct sk_buff *skb,
 	}
 
 	shinfo->gso_size = le16_to_cpu(desc->rsc_seg_len);
+	if (unlikely(!shinfo->gso_size))
+		return -EINVAL;
+
+	/* GRO may merge RSC packets further once gro_max_size is raised above
+	 * 64K, and it accounts for them by gso_segs. The device does not
+	 * report a segment count, so derive it from the payload length.
+	 */
+	if (skb_headlen(skb)) {
+		/* Header split leaves only the payload in the frags */
+		payload_len = skb->data_len;
+	} else {
+		skb_frag_t *frag = &shinfo->frags[0];
+
+		payload_len = skb->len -
+			eth_get_headlen(skb->dev, skb_frag_address(frag),
+					skb_frag_size(frag));
+	}
+	shinfo->gso_segs = DIV_ROUND_UP(payload_len, shinfo->gso_size);
 	return 0;
 }
 
 /* Returns 0 if skb is completed successfully, -1 otherwise. */
 static int gve_rx_complete_skb(struct gve_rx_ring *rx, struct napi_struct *napi,
 			       const struct gve_rx_compl_desc_dqo *desc,
-			       netdev_features_t feat)
+			       netdev_features_t feat, struct gve_rx_cnts *cnts)
 {
 	struct gve_ptype ptype =
 		rx->gve->ptype_lut_dqo->ptypes[desc->packet_type];
@@ -929,6 +1202,9 @@ static int gve_rx_complete_skb(struct gve_rx_ring *rx, struct napi_struct *napi,
 		err = gve_rx_complete_rsc(rx->ctx.skb_head, desc, ptype);
 		if (err < 0)
 			return err;
+
+		cnts->rsc_pkt_cnt++;
+		cnts->rsc_seg_cnt += skb_shinfo(rx->ctx.skb_head)->gso_segs;
 	}
 
 	if (skb_headlen(rx->ctx.skb_head) == 0)
@@ -947,8 +1223,8 @@ int gve_rx_poll_dqo(struct gve_notify_block *block, int budget)
 	struct gve_rx_ring *rx = block->rx;
 	struct gve_rx_compl_queue_dqo *complq = &rx->dqo.complq;
 
+	struct gve_rx_cnts cnts = {0};
 	u32 work_done = 0;
-	u64 bytes = 0;
 	int err;
 
 	while (work_done < budget) {
@@ -967,17 +1243,19 @@ int gve_rx_poll_dqo(struct gve_notify_block *block, int budget)
 		/* Do not read data until we own the descriptor */
 		dma_rmb();
 
-		err = gve_rx_dqo(napi, rx, compl_desc, rx->q_num);
-		if (err < 0) {
-			gve_rx_free_skb(rx);
-			u64_stats_update_begin(&rx->statss);
-			if (err == -ENOMEM)
-				rx->rx_skb_alloc_fail++;
-			else if (err == -EINVAL)
-				rx->rx_desc_err_dropped_pkt++;
-			else if (err == -EFAULT)
-				rx->rx_hsplit_err_dropped_pkt++;
-			u64_stats_update_end(&rx->statss);
+		err = gve_rx_dqo(napi, rx, compl_desc, rx->q_num, &cnts);
+		trace_gve_rx_dqo(rx, compl_desc, err);
+		if (err == -ENOMEM) {
+			gve_rx_free_skb(rx, GVE_DROP_RX_NOMEM);
+			cnts.skb_alloc_fail_cnt++;
+		} else if (err == -EINVAL) {
+			gve_rx_free_skb(rx, GVE_DROP_RX_DESC_ERR);
+			cnts.desc_err_pkt_cnt++;
+		} else if (err == -EFAULT) {
+			gve_rx_free_skb(rx, GVE_DROP_RX_HSPLIT_ERR);
+			cnts.hsplit_err_pkt_cnt++;
+		} else if (err < 0) {
+			gve_rx_free_skb(rx, GVE_DROP_RX_DESC_ERR);
 		}
 
 		complq->head = (complq->head + 1) & complq->mask;
@@ -1013,25 +1291,22 @@ int gve_rx_poll_dqo(struct gve_notify_block *block, int budget)
 			pkt_bytes += ETH_HLEN;
 
 		/* gve_rx_complete_skb() will consume skb if successful */
-		if (gve_rx_complete_skb(rx, napi, compl_desc, feat) != 0) {
-			gve_rx_free_skb(rx);
-			u64_stats_update_begin(&rx->statss);
-			rx->rx_desc_err_dropped_pkt++;
-			u64_stats_update_end(&rx->statss);
+		if (gve_rx_complete_skb(rx, napi, compl_desc, feat,
+					&cnts) != 0) {
+			gve_rx_free_skb(rx, GVE_DROP_RX_RSC_ERR);
+			cnts.desc_err_pkt_cnt++;
 			continue;
 		}
 
-		bytes += pkt_bytes;
+		cnts.ok_pkt_cnt++;
+		cnts.ok_pkt_bytes += pkt_bytes;
 		rx->ctx.skb_head = NULL;
 		rx->ctx.skb_tail = NULL;
 	}
 
 	gve_rx_post_buffers_dqo(rx);
 
-	u64_stats_update_begin(&rx->statss);
-	rx->rpackets += work_done;
-	rx->rbytes += bytes;
-	u64_stats_update_end(&rx->statss);
+	gve_rx_update_stats(rx, &cnts);
 
 	return work_done;
 }
@@ -1043,31 +1318,30 @@ int gve_rx_handle_hdr_resources_dqo(struct gve_priv *priv,
 	int i;
 
 	if (enable_hdr_split) {
-		err = gve_rx_alloc_hdr_buf_pool(priv);
-		if (err)
-			goto err;
+		gve_rx_init_hdr_buf_truesize(priv);
 
 		for (i = 0; i < priv->rx_cfg.num_queues; i++) {
 			err = gve_rx_alloc_hdr_bufs(priv, i);
 			if (err)
-				goto free_buf_pool;
+				goto free_hdr_bufs;
 		}
 	} else {
 		for (i = 0; i < priv->rx_cfg.num_queues; i++)
 			gve_rx_free_hdr_bufs(priv, i);
 
-		dma_pool_destroy(priv->header_buf_pool);
-		priv->header_buf_pool = NULL;
+		priv->header_buf_truesize = 0;
 	}
 
 	return 0;
 
-free_buf_pool:
+free_hdr_bufs:
 	for (i--; i >= 0; i--)
 		gve_rx_free_hdr_bufs(priv, i);
 
-	dma_pool_destroy(priv->header_buf_pool);
-	priv->header_buf_pool = NULL;
-err:
+	priv->header_buf_truesize = 0;
 	return err;
 }
+
+#if IS_ENABLED(CONFIG_GVE_KUNIT_TEST)
+#include "gve_rx_dqo_kunit.c"
+#endif
@@ -0,0 +1,402 @@
+// SPDX-License-Identifier: (GPL-2.0 OR MIT)
+/* Google virtual Ethernet (gve) driver
+ *
+ * Copyright (C) 2015-2024 Google, Inc.
+ */
+
+/* KUnit tests for the DQO RX completion handler. Included at the end of
+ * gve_rx_dqo.c so the static functions are in scope.
+ *
+ * Each case posts buffers from a ring built in ordinary memory and feeds
+ * gve_rx_dqo() the completion descriptor the device would have written.
+ */
+
+#include "gve_kunit.h"
+
+#define GVE_TEST_BUF_STATES	4
+#define GVE_TEST_QUEUE_SLOTS	8
+#define GVE_TEST_HDR_LEN	54
+
+struct gve_rx_dqo_test {
+	struct net_device *dev;
+	struct gve_priv *priv;
+	struct gve_rx_ring *rx;
+	struct napi_struct *napi;
+	struct gve_header_buf *hdr_buf;
+	struct gve_rx_cnts cnts;
+};
+
+static int gve_rx_dqo_test_init(struct kunit *test)
+{
+	struct gve_rx_dqo_test *t;
+	struct gve_priv *priv;
+	struct gve_rx_ring *rx;
+	struct pci_dev *pdev;
+
+	t = kunit_kzalloc(test, sizeof(*t), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, t);
+	test->priv = t;
+
+	t->dev = alloc_etherdev(0);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, t->dev);
+	t->napi = kunit_kzalloc(test, sizeof(*t->napi), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, t->napi);
+	t->napi->dev = t->dev;
+
+	/* A bare device with a DMA mask is all the direct mapping of the
+	 * buffer pages needs.
+	 */
+	pdev = kunit_kzalloc(test, sizeof(*pdev), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, pdev);
+	pdev->dev.coherent_dma_mask = DMA_BIT_MASK(64);
+	pdev->dev.dma_mask = &pdev->dev.coherent_dma_mask;
+
+	priv = kunit_kzalloc(test, sizeof(*priv), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, priv);
+	t->priv = priv;
+	priv->dev = t->dev;
+	priv->pdev = pdev;
+	priv->data_buffer_size_dqo = GVE_RX_BUFFER_SIZE_DQO;
+	priv->header_buf_size = GVE_HEADER_BUFFER_SIZE_DEFAULT;
+	gve_rx_init_hdr_buf_truesize(priv);
+
+	rx = kunit_kzalloc(test, sizeof(*rx), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, rx);
+	t->rx = rx;
+	rx->gve = priv;
+
+	rx->dqo.num_buf_states = GVE_TEST_BUF_STATES;
+	rx->dqo.buf_states = kunit_kcalloc(test, GVE_TEST_BUF_STATES,
+					   sizeof(rx->dqo.buf_states[0]),
+					   GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, rx->dqo.buf_states);
+	rx->dqo.free_buf_states.ids =
+		kunit_kcalloc(test, GVE_TEST_BUF_STATES,
+			      sizeof(rx->dqo.free_buf_states.ids[0]),
+			      GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, rx->dqo.free_buf_states.ids);
+	KUNIT_ASSERT_EQ(test, gve_alloc_index_ring(&rx->dqo.recycled_buf_states,
+						   GVE_TEST_BUF_STATES), 0);
+	KUNIT_ASSERT_EQ(test, gve_alloc_index_ring(&rx->dqo.used_buf_states,
+						   GVE_TEST_BUF_STATES), 0);
+
+	rx->dqo.num_hdr_pages = 1;
+	rx->dqo.hdr_pages = kunit_kzalloc(test, sizeof(*rx->dqo.hdr_pages),
+					  GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, rx->dqo.hdr_pages);
+	t->hdr_buf = kunit_kzalloc(test, sizeof(*t->hdr_buf), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, t->hdr_buf);
+
+	gve_rx_init_ring_state_dqo(rx, GVE_TEST_QUEUE_SLOTS,
+				   GVE_TEST_QUEUE_SLOTS);
+
+	return 0;
+}
+
+static void gve_rx_dqo_test_exit(struct kunit *test)
+{
+	struct gve_rx_dqo_test *t = test->priv;
+	struct gve_rx_ring *rx;
+	int i;
+
+	if (!t || !t->rx)
+		goto free_netdev;
+	rx = t->rx;
+
+	/* The skb gives its page references back before the pages go. */
+	kfree_skb(rx->ctx.skb_head);
+
+	for (i = 0; rx->dqo.buf_states && i < rx->dqo.num_buf_states; i++)
+		if (rx->dqo.buf_states[i].page_info.page)
+			gve_free_page_dqo(t->priv, &rx->dqo.buf_states[i],
+					  true);
+	if (rx->dqo.hdr_pages && rx->dqo.hdr_pages[0].page_info.page)
+		gve_free_hdr_page(t->priv, &rx->dqo.hdr_pages[0]);
+
+	kvfree(rx->dqo.recycled_buf_states.ids);
+	kvfree(rx->dqo.used_buf_states.ids);
+
+free_netdev:
+	if (t && t->dev)
+		free_netdev(t->dev);
+}
+
+/* Hands a buffer to the "device", as gve_rx_post_buffers_dqo() would, and
+ * returns its buffer id.
+ */
+static u16 gve_rx_dqo_test_post(struct kunit *test, bool hsplit)
+{
+	struct gve_rx_dqo_test *t = test->priv;
+	struct gve_rx_buf_state_dqo *buf_state;
+	struct gve_rx_ring *rx = t->rx;
+
+	buf_state = gve_alloc_buf_state(rx);
+	KUNIT_ASSERT_NOT_NULL(test, buf_state);
+	KUNIT_ASSERT_EQ(test, gve_alloc_page_dqo(rx, buf_state), 0);
+	memset(buf_state->page_info.page_address, 0, PAGE_SIZE);
+
+	if (hsplit) {
+		KUNIT_ASSERT_EQ(test, gve_get_hdr_buf(rx, t->hdr_buf), 0);
+		memset(t->hdr_buf->data, 0, t->priv->header_buf_size);
+		buf_state->hdr_buf = t->hdr_buf;
+	}
+
+	return buf_state - rx->dqo.buf_states;
+}
+
+static int gve_rx_dqo_test_rx(struct kunit *test,
+			      const struct gve_rx_compl_desc_dqo *desc)
+{
+	struct gve_rx_dqo_test *t = test->priv;
+	int ret;
+
+	/* napi skb allocation expects to run in softirq context. */
+	local_bh_disable();
+	GVE_KUNIT_CYCLES(test,
+			 ret = gve_rx_dqo(t->napi, t->rx, desc, 0, &t->cnts));
+	local_bh_enable();
+
+	return ret;
+}
+
+struct gve_rx_dqo_err_case {
+	const char *name;
+	bool hsplit;
+	bool rx_error;
+	bool sph;
+	bool hbo;
+	bool strict;
+	u16 hdr_len;
+	int ret;
+};
+
+static const struct gve_rx_dqo_err_case gve_rx_dqo_err_cases[] = {
+	{
+		.name = "rx_error",
+		.rx_error = true,
+		.ret = -EINVAL,
+	},
+	{
+		.name = "split_header_without_len",
+		.hsplit = true,
+		.sph = true,
+		.ret = -EINVAL,
+	},
+	{
+		.name = "header_larger_than_slot",
+		.hsplit = true,
+		.sph = true,
+		.hdr_len = GVE_HEADER_BUFFER_SIZE_DEFAULT + 1,
+		.ret = -EFAULT,
+	},
+	{
+		.name = "header_without_header_buf",
+		.sph = true,
+		.hdr_len = GVE_TEST_HDR_LEN,
+		.ret = -EINVAL,
+	},
+	{
+		.name = "overflow_in_strict_mode",
+		.hsplit = true,
+		.sph = true,
+		.hbo = true,
+		.strict = true,
+		.hdr_len = GVE_TEST_HDR_LEN,
+		.ret = -EFAULT,
+	},
+};
+
+static void gve_rx_dqo_err_case_desc(const struct gve_rx_dqo_err_case *c,
+				     char *desc)
+{
+	strscpy(desc, c->name, KUNIT_PARAM_DESC_SIZE);
+}
+
+KUNIT_ARRAY_PARAM(gve_rx_dqo_err, gve_rx_dqo_err_cases,
+		  gve_rx_dqo_err_case_desc);
+
+static void gve_rx_dqo_test_bad_desc(struct kunit *test)
+{
+	const struct gve_rx_dqo_err_case *c = test->param_value;
+	struct gve_rx_dqo_test *t = test->priv;
+	struct gve_rx_compl_desc_dqo desc = {};
+	struct gve_rx_buf_state_dqo *buf_state;
+	struct gve_rx_ring *rx = t->rx;
+	u16 buf_id;
+
+	t->priv->header_split_strict = c->strict;
+	buf_id = gve_rx_dqo_test_post(test, c->hsplit);
+	buf_state = &rx->dqo.buf_states[buf_id];
+
+	desc.buf_id = cpu_to_le16(buf_id);
+	desc.rx_error = c->rx_error;
+	desc.split_header = c->sph;
+	desc.header_buffer_overflow = c->hbo;
+	desc.header_len = c->hdr_len;
+	desc.packet_len = 1000;
+	desc.end_of_packet = 1;
+
+	KUNIT_EXPECT_EQ(test, gve_rx_dqo_test_rx(test, &desc), c->ret);
+
+	/* The buffer goes straight back to the device, untouched. */
+	KUNIT_EXPECT_NULL(test, rx->ctx.skb_head);
+	KUNIT_EXPECT_FALSE(test, buf_state->allocated);
+	KUNIT_EXPECT_NULL(test, buf_state->hdr_buf);
+	KUNIT_EXPECT_EQ(test, buf_state->page_info.page_offset, 0);
+	KUNIT_EXPECT_EQ(test, gve_index_ring_len(&rx->dqo.recycled_buf_states),
+			1);
+	KUNIT_EXPECT_EQ(test, gve_buf_ref_cnt(buf_state), 0);
+	KUNIT_EXPECT_EQ(test, t->cnts.hsplit_pkt_cnt, 0);
+}
+
+static void gve_rx_dqo_test_bad_buf_id(struct kunit *test)
+{
+	struct gve_rx_dqo_test *t = test->priv;
+	struct gve_rx_compl_desc_dqo desc = {};
+	struct gve_rx_ring *rx = t->rx;
+	u16 buf_id;
+
+	buf_id = gve_rx_dqo_test_post(test, false);
+
+	desc.buf_id = cpu_to_le16(GVE_TEST_BUF_STATES);
+	desc.packet_len = 100;
+	desc.end_of_packet = 1;
+	KUNIT_EXPECT_EQ(test, gve_rx_dqo_test_rx(test, &desc), -EINVAL);
+
+	/* A buffer the device was never given, e.g. a repeated completion. */
+	desc.buf_id = cpu_to_le16(buf_id + 1);
+	KUNIT_EXPECT_EQ(test, gve_rx_dqo_test_rx(test, &desc), -EINVAL);
+
+	KUNIT_EXPECT_NULL(test, rx->ctx.skb_head);
+	KUNIT_EXPECT_TRUE(test, rx->dqo.buf_states[buf_id].allocated);
+	KUNIT_EXPECT_EQ(test, gve_index_ring_len(&rx->dqo.recycled_buf_states),
+			0);
+}
+
+static void gve_rx_dqo_test_hsplit_overflow(struct kunit *test)
+{
+	struct gve_rx_dqo_test *t = test->priv;
+	struct gve_rx_compl_desc_dqo desc = {};
+	struct gve_rx_buf_state_dqo *buf_state;
+	struct gve_rx_ring *rx = t->rx;
+	struct sk_buff *skb;
+	u16 buf_id;
+
+	buf_id = gve_rx_dqo_test_post(test, true);
+	buf_state = &rx->dqo.buf_states[buf_id];
+
+	/* Outside strict mode an overflowed header is still delivered, with
+	 * the payload attached as a frag.
+	 */
+	desc.buf_id = cpu_to_le16(buf_id);
+	desc.split_header = 1;
+	desc.header_buffer_overflow = 1;
+	desc.header_len = GVE_TEST_HDR_LEN;
+	desc.packet_len = 1000;
+	desc.end_of_packet = 1;
+	KUNIT_EXPECT_EQ(test, gve_rx_dqo_test_rx(test, &desc), 0);
+
+	KUNIT_EXPECT_EQ(test, t->cnts.hsplit_pkt_cnt, 1);
+	KUNIT_EXPECT_EQ(test, t->cnts.hsplit_hbo_pkt_cnt, 1);
+	KUNIT_EXPECT_EQ(test, t->cnts.header_bytes, GVE_TEST_HDR_LEN);
+
+	skb = rx->ctx.skb_head;
+	KUNIT_ASSERT_NOT_NULL(test, skb);
+	KUNIT_EXPECT_PTR_EQ(test, rx->ctx.skb_tail, skb);
+	KUNIT_EXPECT_EQ(test, skb->len, GVE_TEST_HDR_LEN - ETH_HLEN + 1000);
+	KUNIT_EXPECT_EQ(test, skb_headlen(skb), GVE_TEST_HDR_LEN - ETH_HLEN);
+	KUNIT_EXPECT_EQ(test, skb_shinfo(skb)->nr_frags, 1);
+
+	/* The skb holds the only reference to the first half of the page, so
+	 * the second half is handed straight back to the device.
+	 */
+	KUNIT_EXPECT_EQ(test, gve_buf_ref_cnt(buf_state), 1);
+	KUNIT_EXPECT_EQ(test, buf_state->page_info.page_offset,
+			GVE_RX_BUFFER_SIZE_DQO);
+	KUNIT_EXPECT_NULL(test, buf_state->hdr_buf);
+	KUNIT_EXPECT_EQ(test, gve_index_ring_len(&rx->dqo.recycled_buf_states),
+			1);
+}
+
+static void gve_rx_dqo_test_overflow_large_header(struct kunit *test)
+{
+	struct gve_rx_dqo_test *t = test->priv;
+	struct gve_rx_compl_desc_dqo desc = {};
+	struct gve_rx_buf_state_dqo *buf_state;
+	struct gve_rx_ring *rx = t->rx;
+	struct sk_buff *skb;
+	u16 buf_id;
+
+	buf_id = gve_rx_dqo_test_post(test, true);
+	buf_state = &rx->dqo.buf_states[buf_id];
+
+	/* A header too large for the header buffer was not split, so the
+	 * whole packet is in the data buffer and is delivered from there.
+	 */
+	desc.buf_id = cpu_to_le16(buf_id);
+	desc.header_buffer_overflow = 1;
+	desc.header_len = GVE_HEADER_BUFFER_SIZE_DEFAULT + 72;
+	desc.packet_len = 1000;
+	desc.end_of_packet = 1;
+	KUNIT_EXPECT_EQ(test, gve_rx_dqo_test_rx(test, &desc), 0);
+
+	KUNIT_EXPECT_EQ(test, t->cnts.hsplit_pkt_cnt, 0);
+	skb = rx->ctx.skb_head;
+	KUNIT_ASSERT_NOT_NULL(test, skb);
+	KUNIT_EXPECT_EQ(test, skb->len, 1000);
+	KUNIT_EXPECT_EQ(test, skb_shinfo(skb)->nr_frags, 1);
+
+	KUNIT_EXPECT_EQ(test, gve_buf_ref_cnt(buf_state), 1);
+	KUNIT_EXPECT_EQ(test, buf_state->page_info.page_offset,
+			GVE_RX_BUFFER_SIZE_DQO);
+	KUNIT_EXPECT_EQ(test, gve_index_ring_len(&rx->dqo.recycled_buf_states),
+			1);
+}
+
+static void gve_rx_dqo_test_copybreak(struct kunit *test)
+{
+	struct gve_rx_dqo_test *t = test->priv;
+	struct gve_rx_compl_desc_dqo desc = {};
+	struct gve_rx_buf_state_dqo *buf_state;
+	struct gve_rx_ring *rx = t->rx;
+	u16 buf_id;
+
+	t->priv->rx_copybreak = 256;
+	buf_id = gve_rx_dqo_test_post(test, false);
+	buf_state = &rx->dqo.buf_states[buf_id];
+
+	desc.buf_id = cpu_to_le16(buf_id);
+	desc.packet_len = 200;
+	desc.end_of_packet = 1;
+	KUNIT_EXPECT_EQ(test, gve_rx_dqo_test_rx(test, &desc), 0);
+
+	KUNIT_EXPECT_EQ(test, t->cnts.copied_pkt_cnt, 1);
+	KUNIT_EXPECT_EQ(test, t->cnts.copybreak_pkt_cnt, 1);
+	KUNIT_ASSERT_NOT_NULL(test, rx->ctx.skb_head);
+	KUNIT_EXPECT_EQ(test, rx->ctx.skb_head->len, 200 - ETH_HLEN);
+	KUNIT_EXPECT_EQ(test, skb_shinfo(rx->ctx.skb_head)->nr_frags, 0);
+
+	/* The data was copied out, so the same offset is reused. */
+	KUNIT_EXPECT_EQ(test, gve_buf_ref_cnt(buf_state), 0);
+	KUNIT_EXPECT_EQ(test, buf_state->page_info.page_offset, 0);
+	KUNIT_EXPECT_EQ(test, gve_index_ring_len(&rx->dqo.recycled_buf_states),
+			1);
+}
+
+static struct kunit_case gve_rx_dqo_test_cases[] = {
+	KUNIT_CASE_PARAM(gve_rx_dqo_test_bad_desc, gve_rx_dqo_err_gen_params),
+	KUNIT_CASE(gve_rx_dqo_test_bad_buf_id),
+	KUNIT_CASE(gve_rx_dqo_test_hsplit_overflow),
+	KUNIT_CASE(gve_rx_dqo_test_overflow_large_header),
+	KUNIT_CASE(gve_rx_dqo_test_copybreak),
+	{}
+};
+
+static struct kunit_suite gve_rx_dqo_test_suite = {
+	.name = "gve_rx_dqo",
+	.init = gve_rx_dqo_test_init,
+	.exit = gve_rx_dqo_test_exit,
+	.test_cases = gve_rx_dqo_test_cases,
+};
+
+kunit_test_suite(gve_rx_dqo_test_suite);
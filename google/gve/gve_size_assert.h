@@ -7,3 +7,28 @@
 #ifndef static_assert
 #define static_assert(expr, ...) _Static_assert(expr, #expr)
 #endif /* static_assert */
+
+/* Layout checks for the datapath structs. These are only evaluated once, at
+ * the end of gve.h, where all of the structs are complete.
+ *
+ * Only the ordering that the ____cacheline_aligned markers in gve.h guarantee
+ * is checked: each group of gve_rx_ring starts on its own cacheline, after the
+ * group before it. Update them together with any intended change to the
+ * cacheline partitioning.
+ */
+#if defined(GVE_SIZE_ASSERT_LAYOUT) && !defined(_GVE_SIZE_ASSERT_LAYOUT_H)
+#define _GVE_SIZE_ASSERT_LAYOUT_H
+
+/* gve_rx_ring: read-mostly fields start a cacheline after rx processing. */
+static_assert(offsetof(struct gve_rx_ring, gve) % SMP_CACHE_BYTES == 0);
+/* gve_rx_ring: stats share no cacheline with the read-mostly fields. */
+static_assert(offsetof(struct gve_rx_ring, rbytes) % SMP_CACHE_BYTES == 0);
+static_assert(offsetof(struct gve_rx_ring, rbytes) >
+	      offsetof(struct gve_rx_ring, gve));
+/* gve_rx_ring: slow-path fields share no cacheline with the stats. */
+static_assert(offsetof(struct gve_rx_ring, q_resources_bus) %
+	      SMP_CACHE_BYTES == 0);
+static_assert(offsetof(struct gve_rx_ring, q_resources_bus) >
+	      offsetof(struct gve_rx_ring, rbytes));
+
+#endif /* GVE_SIZE_ASSERT_LAYOUT && !_GVE_SIZE_ASSERT_LAYOUT_H */
@@ -0,0 +1,311 @@
+/* SPDX-License-Identifier: (GPL-2.0 OR MIT)
+ * Google virtual Ethernet (gve) driver
+ *
+ * Copyright (C) 2015-2024 Google, Inc.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM gve
+
+#if !defined(_GVE_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _GVE_TRACE_H
+
+#include <linux/tracepoint.h>
+#include "gve.h"
+#include "gve_adminq.h"
+
+#define GVE_TRACE_DB_TX		0
+#define GVE_TRACE_DB_RX		1
+#define GVE_TRACE_DB_IRQ	2
+
+#define gve_trace_db_types				\
+	{ GVE_TRACE_DB_TX,	"tx" },			\
+	{ GVE_TRACE_DB_RX,	"rx" },			\
+	{ GVE_TRACE_DB_IRQ,	"irq" }
+
+#define gve_trace_compl_types_dqo				\
+	{ GVE_COMPL_TYPE_DQO_PKT,		"pkt" },	\
+	{ GVE_COMPL_TYPE_DQO_DESC,		"desc" },	\
+	{ GVE_COMPL_TYPE_DQO_MISS,		"miss" },	\
+	{ GVE_COMPL_TYPE_DQO_REINJECTION,	"reinjection" }
+
+#define gve_trace_drop_reasons						\
+	EM(GVE_DROP_RX_DESC_ERR,	"rx_desc_err")			\
+	EM(GVE_DROP_RX_FRAG_SIZE,	"rx_frag_size")			\
+	EM(GVE_DROP_RX_INCOMPLETE,	"rx_incomplete")		\
+	EM(GVE_DROP_RX_HSPLIT_ERR,	"rx_hsplit_err")		\
+	EM(GVE_DROP_RX_RSC_ERR,		"rx_rsc_err")			\
+	EM(GVE_DROP_RX_NOMEM,		"rx_nomem")			\
+	EM(GVE_DROP_TX_MAP_ERR,		"tx_map_err")			\
+	EM(GVE_DROP_TX_LINEARIZE,	"tx_linearize")			\
+	EM(GVE_DROP_TX_JUMBO,		"tx_jumbo")			\
+	EMe(GVE_DROP_TX_COMPL_TIMEOUT,	"tx_compl_timeout")
+
+#undef EM
+#undef EMe
+#define EM(a, b)	TRACE_DEFINE_ENUM(a);
+#define EMe(a, b)	TRACE_DEFINE_ENUM(a);
+
+gve_trace_drop_reasons
+
+#undef EM
+#undef EMe
+#define EM(a, b)	{ a, b },
+#define EMe(a, b)	{ a, b }
+
+/* One GQI rx descriptor, after it was handled */
+TRACE_EVENT(gve_rx,
+	TP_PROTO(const struct gve_rx_ring *rx, const struct gve_rx_desc *desc,
+		 bool eop),
+
+	TP_ARGS(rx, desc, eop),
+
+	TP_STRUCT__entry(
+		__field(u32, queue)
+		__field(u16, len)
+		__field(u8, frag)
+		__field(bool, eop)
+		__field(bool, drop)
+	),
+
+	TP_fast_assign(
+		__entry->queue = rx->q_num;
+		__entry->len = be16_to_cpu(desc->len);
+		__entry->frag = rx->ctx.frag_cnt;
+		__entry->eop = eop;
+		__entry->drop = rx->ctx.drop_pkt;
+	),
+
+	TP_printk("rxq=%u len=%u frag=%u eop=%d drop=%d",
+		  __entry->queue, __entry->len, __entry->frag, __entry->eop,
+		  __entry->drop)
+);
+
+/* One DQO rx completion, after it was handled */
+TRACE_EVENT(gve_rx_dqo,
+	TP_PROTO(const struct gve_rx_ring *rx,
+		 const struct gve_rx_compl_desc_dqo *desc, int err),
+
+	TP_ARGS(rx, desc, err),
+
+	TP_STRUCT__entry(
+		__field(u32, queue)
+		__field(u16, len)
+		__field(u8, frags)
+		__field(bool, eop)
+		__field(int, err)
+	),
+
+	TP_fast_assign(
+		__entry->queue = rx->q_num;
+		__entry->len = desc->packet_len;
+		__entry->frags = rx->ctx.skb_head ?
+			skb_shinfo(rx->ctx.skb_head)->nr_frags : 0;
+		__entry->eop = desc->end_of_packet;
+		__entry->err = err;
+	),
+
+	TP_printk("rxq=%u len=%u frags=%u eop=%d err=%d",
+		  __entry->queue, __entry->len, __entry->frags, __entry->eop,
+		  __entry->err)
+);
+
+TRACE_EVENT(gve_tx_enqueue,
+	TP_PROTO(const struct gve_tx_ring *tx, const struct sk_buff *skb,
+		 u32 descs),
+
+	TP_ARGS(tx, skb, descs),
+
+	TP_STRUCT__entry(
+		__field(u32, queue)
+		__field(u32, descs)
+		__field(u32, bytes)
+		__field(u16, gso_segs)
+	),
+
+	TP_fast_assign(
+		__entry->queue = tx->q_num;
+		__entry->descs = descs;
+		__entry->bytes = skb->len;
+		__entry->gso_segs = skb_shinfo(skb)->gso_segs;
+	),
+
+	TP_printk("txq=%u descs=%u bytes=%u gso_segs=%u",
+		  __entry->queue, __entry->descs, __entry->bytes,
+		  __entry->gso_segs)
+);
+
+/* One pass of GQI completion cleaning */
+TRACE_EVENT(gve_tx_complete,
+	TP_PROTO(const struct gve_tx_ring *tx, u32 descs, u64 pkts, u64 bytes),
+
+	TP_ARGS(tx, descs, pkts, bytes),
+
+	TP_STRUCT__entry(
+		__field(u32, queue)
+		__field(u32, descs)
+		__field(u64, pkts)
+		__field(u64, bytes)
+	),
+
+	TP_fast_assign(
+		__entry->queue = tx->q_num;
+		__entry->descs = descs;
+		__entry->pkts = pkts;
+		__entry->bytes = bytes;
+	),
+
+	TP_printk("txq=%u descs=%u pkts=%llu bytes=%llu",
+		  __entry->queue, __entry->descs, __entry->pkts,
+		  __entry->bytes)
+);
+
+/* One DQO tx completion descriptor */
+TRACE_EVENT(gve_tx_complete_dqo,
+	TP_PROTO(const struct gve_tx_ring *tx,
+		 const struct gve_tx_compl_desc *desc),
+
+	TP_ARGS(tx, desc),
+
+	TP_STRUCT__entry(
+		__field(u32, queue)
+		__field(u8, type)
+		__field(u16, tag)
+	),
+
+	TP_fast_assign(
+		__entry->queue = tx->q_num;
+		__entry->type = desc->type;
+		__entry->tag = le16_to_cpu(desc->completion_tag);
+	),
+
+	TP_printk("txq=%u type=%s %s=%u",
+		  __entry->queue,
+		  __print_symbolic(__entry->type, gve_trace_compl_types_dqo),
+		  __entry->type == GVE_COMPL_TYPE_DQO_DESC ? "head" : "tag",
+		  __entry->tag)
+);
+
+/* An skb freed by the driver without being delivered or transmitted */
+TRACE_EVENT(gve_drop,
+	TP_PROTO(const struct sk_buff *skb, u32 queue,
+		 enum gve_drop_reason reason),
+
+	TP_ARGS(skb, queue, reason),
+
+	TP_STRUCT__entry(
+		__field(u32, queue)
+		__field(u32, len)
+		__field(u8, reason)
+	),
+
+	TP_fast_assign(
+		__entry->queue = queue;
+		__entry->len = skb->len;
+		__entry->reason = reason;
+	),
+
+	TP_printk("queue=%u len=%u reason=%s", __entry->queue, __entry->len,
+		  __print_symbolic(__entry->reason, gve_trace_drop_reasons))
+);
+
+/* An MMIO doorbell write. Queue is the notify block index for irqs. */
+TRACE_EVENT(gve_doorbell,
+	TP_PROTO(u8 type, u32 queue, u32 val),
+
+	TP_ARGS(type, queue, val),
+
+	TP_STRUCT__entry(
+		__field(u8, type)
+		__field(u32, queue)
+		__field(u32, val)
+	),
+
+	TP_fast_assign(
+		__entry->type = type;
+		__entry->queue = queue;
+		__entry->val = val;
+	),
+
+	TP_printk("%s queue=%u val=%#x",
+		  __print_symbolic(__entry->type, gve_trace_db_types),
+		  __entry->queue, __entry->val)
+);
+
+/* The caller identifies the reason for the reset */
+TRACE_EVENT(gve_schedule_reset,
+	TP_PROTO(const struct gve_priv *priv, unsigned long caller),
+
+	TP_ARGS(priv, caller),
+
+	TP_STRUCT__entry(
+		__field(int, ifindex)
+		__field(unsigned long, caller)
+	),
+
+	TP_fast_assign(
+		__entry->ifindex = priv->dev->ifindex;
+		__entry->caller = caller;
+	),
+
+	TP_printk("ifindex=%d caller=%pS", __entry->ifindex,
+		  (void *)__entry->caller)
+);
+
+TRACE_EVENT(gve_adminq_cmd_issue,
+	TP_PROTO(const struct gve_priv *priv,
+		 const union gve_adminq_command *cmd),
+
+	TP_ARGS(priv, cmd),
+
+	TP_STRUCT__entry(
+		__field(int, ifindex)
+		__field(u32, opcode)
+		__field(u32, prod_cnt)
+	),
+
+	TP_fast_assign(
+		__entry->ifindex = priv->dev->ifindex;
+		__entry->opcode = gve_adminq_cmd_opcode(cmd);
+		__entry->prod_cnt = priv->adminq_prod_cnt;
+	),
+
+	TP_printk("ifindex=%d opcode=%#x prod_cnt=%u", __entry->ifindex,
+		  __entry->opcode, __entry->prod_cnt)
+);
+
+/* Latency is measured from the doorbell kick that flushed the command */
+TRACE_EVENT(gve_adminq_cmd_complete,
+	TP_PROTO(const struct gve_priv *priv,
+		 const union gve_adminq_command *cmd, u32 status,
+		 u64 latency_ns),
+
+	TP_ARGS(priv, cmd, status, latency_ns),
+
+	TP_STRUCT__entry(
+		__field(int, ifindex)
+		__field(u32, opcode)
+		__field(u32, status)
+		__field(u64, latency_ns)
+	),
+
+	TP_fast_assign(
+		__entry->ifindex = priv->dev->ifindex;
+		__entry->opcode = gve_adminq_cmd_opcode(cmd);
+		__entry->status = status;
+		__entry->latency_ns = latency_ns;
+	),
+
+	TP_printk("ifindex=%d opcode=%#x status=%#x latency_ns=%llu",
+		  __entry->ifindex, __entry->opcode, __entry->status,
+		  __entry->latency_ns)
+);
+
+#endif /* _GVE_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE gve_trace
+
+#include <trace/define_trace.h>
@@ -6,6 +6,7 @@
 
 #include "gve.h"
 #include "gve_adminq.h"
+#include "gve_trace.h"
 #include "gve_utils.h"
 #include <linux/ip.h>
 #include <linux/tcp.h>
@@ -14,10 +15,26 @@
 #include <net/xdp_sock_drv.h>
 
 static inline void gve_tx_put_doorbell(struct gve_priv *priv,
-				       struct gve_queue_resources *q_resources,
-				       u32 val)
+				       struct gve_tx_ring *tx)
 {
-	iowrite32be(val, &priv->db_bar2[be32_to_cpu(q_resources->db_index)]);
+	u32 db_idx = be32_to_cpu(tx->q_resources->db_index);
+
+	/* The NIC already has this tail, writing it again only costs an exit */
+	if (tx->db_val == tx->req) {
+		u64_stats_update_begin(&tx->statss);
+		tx->doorbell_skipped++;
+		u64_stats_update_end(&tx->statss);
+		return;
+	}
+
+	if (static_branch_unlikely(&gve_tx_lat_key))
+		gve_tx_lat_start(priv, tx, tx->req);
+	trace_gve_doorbell(GVE_TRACE_DB_TX, tx->q_num, tx->req);
+	iowrite32be(tx->req, &priv->db_bar2[db_idx]);
+	tx->db_val = tx->req;
+	u64_stats_update_begin(&tx->statss);
+	tx->doorbell_cnt++;
+	u64_stats_update_end(&tx->statss);
 }
 
 void gve_xdp_tx_flush(struct gve_priv *priv, u32 xdp_qid)
@@ -25,7 +42,7 @@ void gve_xdp_tx_flush(struct gve_priv *priv, u32 xdp_qid)
 	u32 tx_qid = gve_xdp_tx_queue_id(priv, xdp_qid);
 	struct gve_tx_ring *tx = &priv->tx[tx_qid];
 
-	gve_tx_put_doorbell(priv, tx->q_resources, tx->req);
+	gve_tx_put_doorbell(priv, tx);
 }
 
 /* gvnic can only transmit from a Registered Segment.
@@ -183,6 +200,10 @@ static int gve_clean_xdp_done(struct gve_priv *priv, struct gve_tx_ring *tx,
 		space_freed += gve_tx_clear_buffer_state(info);
 	}
 
+	if (static_branch_unlikely(&gve_tx_lat_key))
+		gve_tx_lat_complete(priv, tx, tx->done);
+	trace_gve_tx_complete(tx, to_do, pkts, bytes);
+
 	gve_tx_free_fifo(&tx->tx_fifo, space_freed);
 	if (xsk_complete > 0 && tx->xsk_pool)
 		xsk_tx_completed(tx->xsk_pool, xsk_complete);
@@ -695,7 +716,7 @@ netdev_tx_t gve_tx(struct sk_buff *skb, struct net_device *dev)
 		 * may have added descriptors without ringing the doorbell.
 		 */
 
-		gve_tx_put_doorbell(priv, tx->q_resources, tx->req);
+		gve_tx_put_doorbell(priv, tx);
 		return NETDEV_TX_BUSY;
 	}
 	if (tx->raw_addressing)
@@ -705,11 +726,12 @@ netdev_tx_t gve_tx(struct sk_buff *skb, struct net_device *dev)
 
 	/* If the packet is getting sent, we need to update the skb */
 	if (nsegs) {
+		trace_gve_tx_enqueue(tx, skb, nsegs);
 		netdev_tx_sent_queue(tx->netdev_txq, skb->len);
 		skb_tx_timestamp(skb);
 		tx->req += nsegs;
 	} else {
-		dev_kfree_skb_any(skb);
+		gve_drop_skb(skb, tx->q_num, GVE_DROP_TX_MAP_ERR);
 	}
 
 	if (!netif_xmit_stopped(tx->netdev_txq) && netdev_xmit_more())
@@ -718,7 +740,7 @@ netdev_tx_t gve_tx(struct sk_buff *skb, struct net_device *dev)
 	/* Give packets to NIC. Even if this packet failed to send the doorbell
 	 * might need to be rung because of xmit_more.
 	 */
-	gve_tx_put_doorbell(priv, tx->q_resources, tx->req);
+	gve_tx_put_doorbell(priv, tx);
 	return NETDEV_TX_OK;
 }
 
@@ -793,7 +815,7 @@ int gve_xdp_xmit(struct net_device *dev, int n, struct xdp_frame **frames,
 	}
 
 	if (flags & XDP_XMIT_FLUSH)
-		gve_tx_put_doorbell(priv, tx->q_resources, tx->req);
+		gve_tx_put_doorbell(priv, tx);
 
 	spin_unlock(&tx->xdp_lock);
 
@@ -855,6 +877,10 @@ static int gve_clean_tx_done(struct gve_priv *priv, struct gve_tx_ring *tx,
 		}
 	}
 
+	if (static_branch_unlikely(&gve_tx_lat_key))
+		gve_tx_lat_complete(priv, tx, tx->done);
+	trace_gve_tx_complete(tx, to_do, pkts, bytes);
+
 	if (!tx->raw_addressing)
 		gve_tx_free_fifo(&tx->tx_fifo, space_freed);
 	u64_stats_update_begin(&tx->statss);
@@ -910,7 +936,7 @@ static int gve_xsk_tx(struct gve_priv *priv, struct gve_tx_ring *tx,
 	}
 out:
 	if (sent > 0) {
-		gve_tx_put_doorbell(priv, tx->q_resources, tx->req);
+		gve_tx_put_doorbell(priv, tx);
 		xsk_tx_release(tx->xsk_pool);
 	}
 	spin_unlock(&tx->xdp_lock);
@@ -981,3 +1007,7 @@ bool gve_tx_clean_pending(struct gve_priv *priv, struct gve_tx_ring *tx)
 
 	return nic_done != tx->done;
 }
+
+#if IS_ENABLED(CONFIG_GVE_KUNIT_TEST)
+#include "gve_tx_kunit.c"
+#endif
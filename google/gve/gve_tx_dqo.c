@@ -14,59 +14,72 @@
 #include <linux/skbuff.h>
 
 /* Returns true if tx_bufs are available. */
-static bool gve_has_free_tx_qpl_bufs(struct gve_tx_ring *tx, int count)
+static bool gve_has_free_tx_bufs(struct gve_tx_ring *tx, int count)
 {
 	int num_avail;
 
-	if (!tx->dqo.qpl)
-		return true;
-
-	num_avail = tx->dqo.num_tx_qpl_bufs -
-		(tx->dqo_tx.alloc_tx_qpl_buf_cnt -
-		 tx->dqo_tx.free_tx_qpl_buf_cnt);
+	num_avail = tx->dqo.num_tx_bufs -
+		(tx->dqo_tx.alloc_tx_buf_cnt -
+		 tx->dqo_tx.free_tx_buf_cnt);
 
 	if (count <= num_avail)
 		return true;
 
 	/* Update cached value from dqo_compl. */
-	tx->dqo_tx.free_tx_qpl_buf_cnt =
-		atomic_read_acquire(&tx->dqo_compl.free_tx_qpl_buf_cnt);
+	tx->dqo_tx.free_tx_buf_cnt =
+		atomic_read_acquire(&tx->dqo_compl.free_tx_buf_cnt);
 
-	num_avail = tx->dqo.num_tx_qpl_bufs -
-		(tx->dqo_tx.alloc_tx_qpl_buf_cnt -
-		 tx->dqo_tx.free_tx_qpl_buf_cnt);
+	num_avail = tx->dqo.num_tx_bufs -
+		(tx->dqo_tx.alloc_tx_buf_cnt -
+		 tx->dqo_tx.free_tx_buf_cnt);
 
 	return count <= num_avail;
 }
 
 static s16
-gve_alloc_tx_qpl_buf(struct gve_tx_ring *tx)
+gve_alloc_tx_buf(struct gve_tx_ring *tx)
 {
 	s16 index;
 
-	index = tx->dqo_tx.free_tx_qpl_buf_head;
+	index = tx->dqo_tx.free_tx_buf_head;
 
 	/* No TX buffers available, try to steal the list from the
 	 * completion handler.
 	 */
 	if (unlikely(index == -1)) {
-		tx->dqo_tx.free_tx_qpl_buf_head =
-			atomic_xchg(&tx->dqo_compl.free_tx_qpl_buf_head, -1);
-		index = tx->dqo_tx.free_tx_qpl_buf_head;
+		tx->dqo_tx.free_tx_buf_head =
+			atomic_xchg(&tx->dqo_compl.free_tx_buf_head, -1);
+		index = tx->dqo_tx.free_tx_buf_head;
 
 		if (unlikely(index == -1))
 			return index;
 	}
 
 	/* Remove TX buf from free list */
-	tx->dqo_tx.free_tx_qpl_buf_head = tx->dqo.tx_qpl_buf_next[index];
+	tx->dqo_tx.free_tx_buf_head = tx->dqo.tx_buf_next[index];
+	++tx->dqo_tx.alloc_tx_buf_cnt;
 
 	return index;
 }
 
+/* Appends TX buffer `index` to the chain of buffers owned by `pkt`. `tail` is
+ * the last buffer appended so far and is ignored for the first buffer.
+ */
 static void
-gve_free_tx_qpl_bufs(struct gve_tx_ring *tx,
-		     struct gve_tx_pending_packet_dqo *pkt)
+gve_tx_pkt_append_buf(struct gve_tx_ring *tx,
+		      struct gve_tx_pending_packet_dqo *pkt,
+		      s16 tail, s16 index)
+{
+	if (pkt->num_bufs == 0)
+		pkt->tx_buf_head = index;
+	else
+		tx->dqo.tx_buf_next[tail] = index;
+	++pkt->num_bufs;
+}
+
+static void
+gve_free_tx_bufs(struct gve_tx_ring *tx,
+		 struct gve_tx_pending_packet_dqo *pkt)
 {
 	s16 index;
 	int i;
@@ -74,28 +87,61 @@ gve_free_tx_qpl_bufs(struct gve_tx_ring *tx,
 	if (!pkt->num_bufs)
 		return;
 
-	index = pkt->tx_qpl_buf_ids[0];
-	/* Create a linked list of buffers to be added to the free list */
-	for (i = 1; i < pkt->num_bufs; i++) {
-		tx->dqo.tx_qpl_buf_next[index] = pkt->tx_qpl_buf_ids[i];
-		index = pkt->tx_qpl_buf_ids[i];
-	}
+	/* The packet's buffers are already chained, find the tail */
+	index = pkt->tx_buf_head;
+	for (i = 1; i < pkt->num_bufs; i++)
+		index = tx->dqo.tx_buf_next[index];
 
 	while (true) {
-		s16 old_head = atomic_read_acquire(&tx->dqo_compl.free_tx_qpl_buf_head);
+		s16 old_head = atomic_read_acquire(&tx->dqo_compl.free_tx_buf_head);
 
-		tx->dqo.tx_qpl_buf_next[index] = old_head;
-		if (atomic_cmpxchg(&tx->dqo_compl.free_tx_qpl_buf_head,
+		tx->dqo.tx_buf_next[index] = old_head;
+		if (atomic_cmpxchg(&tx->dqo_compl.free_tx_buf_head,
 				   old_head,
-				   pkt->tx_qpl_buf_ids[0]) == old_head) {
+				   pkt->tx_buf_head) == old_head) {
 			break;
 		}
 	}
 
-	atomic_add(pkt->num_bufs, &tx->dqo_compl.free_tx_qpl_buf_cnt);
+	atomic_add(pkt->num_bufs, &tx->dqo_compl.free_tx_buf_cnt);
 	pkt->num_bufs = 0;
 }
 
+/* Unmaps all of the RDA buffers of `pkt`. The buffers themselves are released
+ * with gve_free_tx_bufs().
+ */
+static void gve_unmap_packet(struct gve_tx_ring *tx,
+			     struct gve_tx_pending_packet_dqo *pkt)
+{
+	struct gve_tx_dma_buf_dqo *buf;
+	s16 index = pkt->tx_buf_head;
+	int i;
+
+	for (i = 0; i < pkt->num_bufs; i++) {
+		buf = &tx->dqo.tx_dma_bufs[index];
+		/* SKB linear portion is always the first buffer */
+		if (i == 0) {
+			dma_unmap_single(tx->dev, dma_unmap_addr(buf, dma),
+					 dma_unmap_len(buf, len),
+					 DMA_TO_DEVICE);
+		} else {
+			dma_unmap_page(tx->dev, dma_unmap_addr(buf, dma),
+				       dma_unmap_len(buf, len),
+				       DMA_TO_DEVICE);
+		}
+		index = tx->dqo.tx_buf_next[index];
+	}
+}
+
+/* Releases the TX buffers of `pkt`, unmapping them first on RDA queues. */
+static void gve_release_tx_bufs(struct gve_tx_ring *tx,
+				struct gve_tx_pending_packet_dqo *pkt)
+{
+	if (!tx->dqo.qpl)
+		gve_unmap_packet(tx, pkt);
+	gve_free_tx_bufs(tx, pkt);
+}
+
 /* Returns true if a gve_tx_pending_packet_dqo object is available. */
 static bool gve_has_pending_packet(struct gve_tx_ring *tx)
 {
@@ -166,21 +212,8 @@ static void gve_tx_clean_pending_packets(struct gve_tx_ring *tx)
 	for (i = 0; i < tx->dqo.num_pending_packets; i++) {
 		struct gve_tx_pending_packet_dqo *cur_state =
 			&tx->dqo.pending_packets[i];
-		int j;
-
-		for (j = 0; j < cur_state->num_bufs; j++) {
-			if (j == 0) {
-				dma_unmap_single(tx->dev,
-					dma_unmap_addr(cur_state, dma[j]),
-					dma_unmap_len(cur_state, len[j]),
-					DMA_TO_DEVICE);
-			} else {
-				dma_unmap_page(tx->dev,
-					dma_unmap_addr(cur_state, dma[j]),
-					dma_unmap_len(cur_state, len[j]),
-					DMA_TO_DEVICE);
-			}
-		}
+
+		gve_release_tx_bufs(tx, cur_state);
 		if (cur_state->skb) {
 			dev_consume_skb_any(cur_state->skb);
 			cur_state->skb = NULL;
@@ -219,8 +252,11 @@ static void gve_tx_free_ring_dqo(struct gve_priv *priv, int idx)
 	kvfree(tx->dqo.pending_packets);
 	tx->dqo.pending_packets = NULL;
 
-	kvfree(tx->dqo.tx_qpl_buf_next);
-	tx->dqo.tx_qpl_buf_next = NULL;
+	kvfree(tx->dqo.tx_buf_next);
+	tx->dqo.tx_buf_next = NULL;
+
+	kvfree(tx->dqo.tx_dma_bufs);
+	tx->dqo.tx_dma_bufs = NULL;
 
 	if (tx->dqo.qpl) {
 		gve_unassign_qpl(priv, tx->dqo.qpl->id);
@@ -230,26 +266,42 @@ static void gve_tx_free_ring_dqo(struct gve_priv *priv, int idx)
 	netif_dbg(priv, drv, priv->dev, "freed tx queue %d\n", idx);
 }
 
-static int gve_tx_qpl_buf_init(struct gve_tx_ring *tx)
+static int gve_tx_buf_init(struct gve_tx_ring *tx)
 {
-	int num_tx_qpl_bufs = GVE_TX_BUFS_PER_PAGE_DQO *
-		tx->dqo.qpl->num_entries;
+	int num_tx_bufs;
 	int i;
 
-	tx->dqo.tx_qpl_buf_next = kvcalloc(num_tx_qpl_bufs,
-					   sizeof(tx->dqo.tx_qpl_buf_next[0]),
-					   GFP_KERNEL);
-	if (!tx->dqo.tx_qpl_buf_next)
+	if (tx->dqo.qpl) {
+		num_tx_bufs = (PAGE_SIZE >> tx->dqo.tx_buf_shift) *
+			tx->dqo.qpl->num_entries;
+	} else {
+		/* Buffers of packets waiting for a reinjection completion
+		 * outlive their descriptors, so allow for twice as many
+		 * buffers as there are descriptors.
+		 */
+		num_tx_bufs = min_t(int, 2 * (tx->mask + 1), S16_MAX);
+
+		tx->dqo.tx_dma_bufs = kvcalloc(num_tx_bufs,
+					       sizeof(tx->dqo.tx_dma_bufs[0]),
+					       GFP_KERNEL);
+		if (!tx->dqo.tx_dma_bufs)
+			return -ENOMEM;
+	}
+
+	tx->dqo.tx_buf_next = kvcalloc(num_tx_bufs,
+				       sizeof(tx->dqo.tx_buf_next[0]),
+				       GFP_KERNEL);
+	if (!tx->dqo.tx_buf_next)
 		return -ENOMEM;
 
-	tx->dqo.num_tx_qpl_bufs = num_tx_qpl_bufs;
+	tx->dqo.num_tx_bufs = num_tx_bufs;
 
 	/* Generate free TX buf list */
-	for (i = 0; i < num_tx_qpl_bufs - 1; i++)
-		tx->dqo.tx_qpl_buf_next[i] = i + 1;
-	tx->dqo.tx_qpl_buf_next[num_tx_qpl_bufs - 1] = -1;
+	for (i = 0; i < num_tx_bufs - 1; i++)
+		tx->dqo.tx_buf_next[i] = i + 1;
+	tx->dqo.tx_buf_next[num_tx_bufs - 1] = -1;
 
-	atomic_set_release(&tx->dqo_compl.free_tx_qpl_buf_head, -1);
+	atomic_set_release(&tx->dqo_compl.free_tx_buf_head, -1);
 	return 0;
 }
 
@@ -330,10 +382,18 @@ static int gve_tx_alloc_ring_dqo(struct gve_priv *priv, int idx)
 		if (!tx->dqo.qpl)
 			goto err;
 
-		if (gve_tx_qpl_buf_init(tx))
-			goto err;
+		/* Larger bounce buffers mean fewer descriptors and completions
+		 * per TSO packet, at the cost of more slack for small packets.
+		 */
+		if (gve_get_enable_max_tx_buffer_size(priv))
+			tx->dqo.tx_buf_shift = GVE_TX_MAX_BUF_SHIFT_DQO;
+		else
+			tx->dqo.tx_buf_shift = GVE_TX_BUF_SHIFT_DQO;
 	}
 
+	if (gve_tx_buf_init(tx))
+		goto err;
+
 	gve_tx_add_to_block(priv, idx);
 
 	return 0;
@@ -395,7 +455,7 @@ static bool gve_has_avail_slots_tx_dqo(struct gve_tx_ring *tx,
 {
 	return gve_has_pending_packet(tx) &&
 		   num_avail_tx_slots(tx) >= desc_count &&
-		   gve_has_free_tx_qpl_bufs(tx, buf_count);
+		   gve_has_free_tx_bufs(tx, buf_count);
 }
 
 /* Stops the queue if available descriptors is less than 'count'.
@@ -573,6 +633,30 @@ gve_tx_fill_general_ctx_desc(struct gve_tx_general_context_desc_dqo *desc,
 	};
 }
 
+/* Records a DMA mapping in a newly allocated TX buffer of `pkt`.
+ *
+ * Returns 0 on success, or -1 if there are no free TX buffers.
+ */
+static int gve_tx_add_dma_buf(struct gve_tx_ring *tx,
+			      struct gve_tx_pending_packet_dqo *pkt,
+			      s16 *tail, dma_addr_t addr, u32 len)
+{
+	struct gve_tx_dma_buf_dqo *buf;
+	s16 index;
+
+	index = gve_alloc_tx_buf(tx);
+	if (unlikely(index == -1))
+		return -1;
+
+	buf = &tx->dqo.tx_dma_bufs[index];
+	dma_unmap_len_set(buf, len, len);
+	dma_unmap_addr_set(buf, dma, addr);
+
+	gve_tx_pkt_append_buf(tx, pkt, *tail, index);
+	*tail = index;
+	return 0;
+}
+
 static int gve_tx_add_skb_no_copy_dqo(struct gve_tx_ring *tx,
 				      struct sk_buff *skb,
 				      struct gve_tx_pending_packet_dqo *pkt,
@@ -581,6 +665,7 @@ static int gve_tx_add_skb_no_copy_dqo(struct gve_tx_ring *tx,
 				      bool is_gso)
 {
 	const struct skb_shared_info *shinfo = skb_shinfo(skb);
+	s16 tail = -1;
 	int i;
 
 	/* Note: HW requires that the size of a non-TSO packet be within the
@@ -601,9 +686,10 @@ static int gve_tx_add_skb_no_copy_dqo(struct gve_tx_ring *tx,
 		if (unlikely(dma_mapping_error(tx->dev, addr)))
 			goto err;
 
-		dma_unmap_len_set(pkt, len[pkt->num_bufs], len);
-		dma_unmap_addr_set(pkt, dma[pkt->num_bufs], addr);
-		++pkt->num_bufs;
+		if (unlikely(gve_tx_add_dma_buf(tx, pkt, &tail, addr, len))) {
+			dma_unmap_single(tx->dev, addr, len, DMA_TO_DEVICE);
+			goto err;
+		}
 
 		gve_tx_fill_pkt_desc_dqo(tx, desc_idx, skb, len, addr,
 					 completion_tag,
@@ -620,9 +706,10 @@ static int gve_tx_add_skb_no_copy_dqo(struct gve_tx_ring *tx,
 		if (unlikely(dma_mapping_error(tx->dev, addr)))
 			goto err;
 
-		dma_unmap_len_set(pkt, len[pkt->num_bufs], len);
-		dma_unmap_addr_set(pkt, dma[pkt->num_bufs], addr);
-		++pkt->num_bufs;
+		if (unlikely(gve_tx_add_dma_buf(tx, pkt, &tail, addr, len))) {
+			dma_unmap_page(tx->dev, addr, len, DMA_TO_DEVICE);
+			goto err;
+		}
 
 		gve_tx_fill_pkt_desc_dqo(tx, desc_idx, skb, len, addr,
 					 completion_tag, is_eop, is_gso);
@@ -630,33 +717,22 @@ static int gve_tx_add_skb_no_copy_dqo(struct gve_tx_ring *tx,
 
 	return 0;
 err:
-	for (i = 0; i < pkt->num_bufs; i++) {
-		if (i == 0) {
-			dma_unmap_single(tx->dev,
-					 dma_unmap_addr(pkt, dma[i]),
-					 dma_unmap_len(pkt, len[i]),
-					 DMA_TO_DEVICE);
-		} else {
-			dma_unmap_page(tx->dev,
-				       dma_unmap_addr(pkt, dma[i]),
-				       dma_unmap_len(pkt, len[i]),
-				       DMA_TO_DEVICE);
-		}
-	}
-	pkt->num_bufs = 0;
+	gve_release_tx_bufs(tx, pkt);
 	return -1;
 }
 
 /* Tx buffer i corresponds to
- * qpl_page_id = i / GVE_TX_BUFS_PER_PAGE_DQO
- * qpl_page_offset = (i % GVE_TX_BUFS_PER_PAGE_DQO) * GVE_TX_BUF_SIZE_DQO
+ * qpl_page_id = i / bufs_per_page
+ * qpl_page_offset = (i % bufs_per_page) * BIT(tx_buf_shift)
+ * where bufs_per_page = PAGE_SIZE >> tx_buf_shift
  */
 static void gve_tx_buf_get_addr(struct gve_tx_ring *tx,
 				s16 index,
 				void **va, dma_addr_t *dma_addr)
 {
-	int page_id = index >> (PAGE_SHIFT - GVE_TX_BUF_SHIFT_DQO);
-	int offset = (index & (GVE_TX_BUFS_PER_PAGE_DQO - 1)) << GVE_TX_BUF_SHIFT_DQO;
+	u8 shift = tx->dqo.tx_buf_shift;
+	int page_id = index >> (PAGE_SHIFT - shift);
+	int offset = (index & ((PAGE_SIZE >> shift) - 1)) << shift;
 
 	*va = page_address(tx->dqo.qpl->pages[page_id]) + offset;
 	*dma_addr = tx->dqo.qpl->page_buses[page_id] + offset;
@@ -671,6 +747,7 @@ static int gve_tx_add_skb_copy_dqo(struct gve_tx_ring *tx,
 {
 	u32 copy_offset = 0;
 	dma_addr_t dma_addr;
+	s16 tail = -1;
 	u32 copy_len;
 	s16 index;
 	void *va;
@@ -678,12 +755,12 @@ static int gve_tx_add_skb_copy_dqo(struct gve_tx_ring *tx,
 	/* Break the packet into buffer size chunks */
 	pkt->num_bufs = 0;
 	while (copy_offset < skb->len) {
-		index = gve_alloc_tx_qpl_buf(tx);
+		index = gve_alloc_tx_buf(tx);
 		if (unlikely(index == -1))
 			goto err;
 
 		gve_tx_buf_get_addr(tx, index, &va, &dma_addr);
-		copy_len = min_t(u32, GVE_TX_BUF_SIZE_DQO,
+		copy_len = min_t(u32, BIT(tx->dqo.tx_buf_shift),
 				 skb->len - copy_offset);
 		skb_copy_bits(skb, copy_offset, va, copy_len);
 
@@ -697,15 +774,14 @@ static int gve_tx_add_skb_copy_dqo(struct gve_tx_ring *tx,
 					 copy_offset == skb->len,
 					 is_gso);
 
-		pkt->tx_qpl_buf_ids[pkt->num_bufs] = index;
-		++tx->dqo_tx.alloc_tx_qpl_buf_cnt;
-		++pkt->num_bufs;
+		gve_tx_pkt_append_buf(tx, pkt, tail, index);
+		tail = index;
 	}
 
 	return 0;
 err:
-	/* Should not be here if gve_has_free_tx_qpl_bufs() check is correct */
-	gve_free_tx_qpl_bufs(tx, pkt);
+	/* Should not be here if gve_has_free_tx_bufs() check is correct */
+	gve_free_tx_bufs(tx, pkt);
 	return -ENOMEM;
 }
 
@@ -756,9 +832,11 @@ static int gve_tx_add_skb_dqo(struct gve_tx_ring *tx,
 	}
 
 	tx->dqo_tx.posted_packet_desc_cnt += pkt->num_bufs;
+	trace_gve_tx_enqueue(tx, skb, (desc_idx - tx->dqo_tx.tail) & tx->mask);
 
 	/* Commit the changes to our state */
 	tx->dqo_tx.tail = desc_idx;
+	tx->dqo_tx.last_compl_tag = completion_tag;
 
 	/* Request a descriptor completion on the last descriptor of the
 	 * packet if we are allowed to by the HW enforced interval.
@@ -849,22 +927,28 @@ static bool gve_can_send_tso(const struct sk_buff *skb)
 static int gve_try_tx_skb(struct gve_priv *priv, struct gve_tx_ring *tx,
 			  struct sk_buff *skb)
 {
+	enum gve_drop_reason reason;
 	int num_buffer_descs;
 	int total_num_descs;
+	int num_bufs;
 
 	if (tx->dqo.qpl) {
 		if (skb_is_gso(skb))
-			if (unlikely(ipv6_hopopt_jumbo_remove(skb)))
+			if (unlikely(ipv6_hopopt_jumbo_remove(skb))) {
+				reason = GVE_DROP_TX_JUMBO;
 				goto drop;
+			}
 
 		/* We do not need to verify the number of buffers used per
-		 * packet or per segment in case of TSO as with 2K size buffers
-		 * none of the TX packet rules would be violated.
+		 * packet or per segment in case of TSO as with 2K or larger
+		 * buffers none of the TX packet rules would be violated.
 		 *
 		 * gve_can_send_tso() checks that each TCP segment of gso_size is
 		 * not distributed over more than 9 SKB frags..
 		 */
-		num_buffer_descs = DIV_ROUND_UP(skb->len, GVE_TX_BUF_SIZE_DQO);
+		num_buffer_descs = DIV_ROUND_UP(skb->len,
+						BIT(tx->dqo.tx_buf_shift));
+		num_bufs = num_buffer_descs;
 	} else {
 		if (skb_is_gso(skb)) {
 			/* If TSO doesn't meet HW requirements, attempt to linearize the
@@ -874,35 +958,45 @@ static int gve_try_tx_skb(struct gve_priv *priv, struct gve_tx_ring *tx,
 				     skb_linearize(skb) < 0)) {
 				net_err_ratelimited("%s: Failed to transmit TSO packet\n",
 						    priv->dev->name);
+				reason = GVE_DROP_TX_LINEARIZE;
 				goto drop;
 			}
 
-			if (unlikely(ipv6_hopopt_jumbo_remove(skb)))
+			if (unlikely(ipv6_hopopt_jumbo_remove(skb))) {
+				reason = GVE_DROP_TX_JUMBO;
 				goto drop;
+			}
 
 			num_buffer_descs = gve_num_buffer_descs_needed(skb);
 		} else {
 			num_buffer_descs = gve_num_buffer_descs_needed(skb);
 
 			if (unlikely(num_buffer_descs > GVE_TX_MAX_DATA_DESCS)) {
-				if (unlikely(skb_linearize(skb) < 0))
+				if (unlikely(skb_linearize(skb) < 0)) {
+					reason = GVE_DROP_TX_LINEARIZE;
 					goto drop;
+				}
 
 				num_buffer_descs = 1;
 			}
 		}
+
+		/* One buffer for the linear portion and one per frag. */
+		num_bufs = 1 + skb_shinfo(skb)->nr_frags;
 	}
 
 	/* Metadata + (optional TSO) + data descriptors. */
 	total_num_descs = 1 + skb_is_gso(skb) + num_buffer_descs;
 	if (unlikely(gve_maybe_stop_tx_dqo(tx, total_num_descs +
 			GVE_TX_MIN_DESC_PREVENT_CACHE_OVERLAP,
-			num_buffer_descs))) {
+			num_bufs))) {
 		return -1;
 	}
 
-	if (unlikely(gve_tx_add_skb_dqo(tx, skb) < 0))
+	if (unlikely(gve_tx_add_skb_dqo(tx, skb) < 0)) {
+		reason = GVE_DROP_TX_MAP_ERR;
 		goto drop;
+	}
 
 	netdev_tx_sent_queue(tx->netdev_txq, skb->len);
 	skb_tx_timestamp(skb);
@@ -910,7 +1004,7 @@ static int gve_try_tx_skb(struct gve_priv *priv, struct gve_tx_ring *tx,
 
 drop:
 	tx->dropped_pkt++;
-	dev_kfree_skb_any(skb);
+	gve_drop_skb(skb, tx->q_num, reason);
 	return 0;
 }
 
@@ -926,14 +1020,14 @@ netdev_tx_t gve_tx_dqo(struct sk_buff *skb, struct net_device *dev)
 		 * queue for want of resources, but prior calls to gve_tx()
 		 * may have added descriptors without ringing the doorbell.
 		 */
-		gve_tx_put_doorbell_dqo(priv, tx->q_resources, tx->dqo_tx.tail);
+		gve_tx_put_doorbell_dqo(priv, tx);
 		return NETDEV_TX_BUSY;
 	}
 
 	if (!netif_xmit_stopped(tx->netdev_txq) && netdev_xmit_more())
 		return NETDEV_TX_OK;
 
-	gve_tx_put_doorbell_dqo(priv, tx->q_resources, tx->dqo_tx.tail);
+	gve_tx_put_doorbell_dqo(priv, tx);
 	return NETDEV_TX_OK;
 }
 
@@ -977,21 +1071,6 @@ static void remove_from_list(struct gve_tx_ring *tx,
 	}
 }
 
-static void gve_unmap_packet(struct device *dev,
-			     struct gve_tx_pending_packet_dqo *pkt)
-{
-	int i;
-
-	/* SKB linear portion is guaranteed to be mapped */
-	dma_unmap_single(dev, dma_unmap_addr(pkt, dma[0]),
-			 dma_unmap_len(pkt, len[0]), DMA_TO_DEVICE);
-	for (i = 1; i < pkt->num_bufs; i++) {
-		dma_unmap_page(dev, dma_unmap_addr(pkt, dma[i]),
-			       dma_unmap_len(pkt, len[i]), DMA_TO_DEVICE);
-	}
-	pkt->num_bufs = 0;
-}
-
 /* Completion types and expected behavior:
  * No Miss compl + Packet compl = Packet completed normally.
  * Miss compl + Re-inject compl = Packet completed normally.
@@ -1038,6 +1117,15 @@ static void gve_handle_packet_completion(struct gve_priv *priv,
 					    priv->dev->name, (int)compl_tag);
 			return;
 		}
+		if (static_branch_unlikely(&gve_tx_lat_key)) {
+			/* timeout_jiffies was set from the miss completion */
+			unsigned long miss_jiffies =
+				pending_packet->timeout_jiffies -
+				msecs_to_jiffies(GVE_REINJECT_COMPL_TIMEOUT *
+						 MSEC_PER_SEC);
+
+			gve_tx_lat_reinject(priv, tx, jiffies - miss_jiffies);
+		}
 		remove_from_list(tx, &tx->dqo_compl.miss_completions,
 				 pending_packet);
 	} else {
@@ -1050,10 +1138,9 @@ static void gve_handle_packet_completion(struct gve_priv *priv,
 		}
 	}
 	tx->dqo_tx.completed_packet_desc_cnt += pending_packet->num_bufs;
-	if (tx->dqo.qpl)
-		gve_free_tx_qpl_bufs(tx, pending_packet);
-	else
-		gve_unmap_packet(tx->dev, pending_packet);
+	gve_release_tx_bufs(tx, pending_packet);
+	if (static_branch_unlikely(&gve_tx_lat_key))
+		gve_tx_lat_complete(priv, tx, compl_tag);
 
 	*bytes += pending_packet->skb->len;
 	(*pkts)++;
@@ -1116,15 +1203,16 @@ static void remove_miss_completions(struct gve_priv *priv,
 		 * can take appropriate action if a corresponding valid
 		 * completion is received later.
 		 */
-		if (tx->dqo.qpl)
-			gve_free_tx_qpl_bufs(tx, pending_packet);
-		else
-			gve_unmap_packet(tx->dev, pending_packet);
+		gve_release_tx_bufs(tx, pending_packet);
 
 		/* This indicates the packet was dropped. */
-		dev_kfree_skb_any(pending_packet->skb);
+		gve_drop_skb(pending_packet->skb, tx->q_num,
+			     GVE_DROP_TX_COMPL_TIMEOUT);
 		pending_packet->skb = NULL;
 		tx->dropped_pkt++;
+		if (static_branch_unlikely(&gve_tx_lat_key))
+			gve_tx_lat_drop(tx, pending_packet -
+					tx->dqo.pending_packets);
 		net_err_ratelimited("%s: No reinjection completion was received for: %d.\n",
 				    priv->dev->name,
 				    (int)(pending_packet - tx->dqo.pending_packets));
@@ -1189,6 +1277,7 @@ int gve_clean_tx_done_dqo(struct gve_priv *priv, struct gve_tx_ring *tx,
 		/* Do not read data until we own the descriptor */
 		dma_rmb();
 		type = compl_desc->type;
+		trace_gve_tx_complete_dqo(tx, compl_desc);
 
 		if (type == GVE_COMPL_TYPE_DQO_DESC) {
 			/* This is the last descriptor fetched by HW plus one */
@@ -1279,3 +1368,7 @@ bool gve_tx_work_pending_dqo(struct gve_tx_ring *tx)
 	struct gve_index_list *miss_comp_list = &tx->dqo_compl.miss_completions;
 	return READ_ONCE(miss_comp_list->head) != -1;
 }
+
+#if IS_ENABLED(CONFIG_GVE_KUNIT_TEST)
+#include "gve_tx_dqo_kunit.c"
+#endif
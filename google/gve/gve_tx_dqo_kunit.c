@@ -0,0 +1,429 @@
+// SPDX-License-Identifier: (GPL-2.0 OR MIT)
+/* Google virtual Ethernet (gve) driver
+ *
+ * Copyright (C) 2015-2024 Google, Inc.
+ */
+
+/* KUnit tests for the DQO TX descriptor writers and completion handling.
+ * Included at the end of gve_tx_dqo.c so the static functions are in scope.
+ *
+ * The completion tests run gve_clean_tx_done_dqo() against a ring that lives
+ * in ordinary memory: the test plays the device by writing completion
+ * descriptors with the generation bit it would use.
+ */
+
+#include "gve_kunit.h"
+
+#define GVE_TEST_TX_RING_SIZE		16
+#define GVE_TEST_COMPLQ_SIZE		8
+#define GVE_TEST_PENDING_PACKETS	4
+#define GVE_TEST_TX_BUFS		16
+#define GVE_TEST_PKT_LEN		1000
+
+struct gve_tx_dqo_test {
+	struct net_device *dev;
+	struct gve_priv *priv;
+	struct gve_tx_ring *tx;
+	u32 compl_tail; /* Next completion the device writes */
+	u8 compl_gen; /* Generation bit the device writes */
+};
+
+static int gve_tx_dqo_test_init(struct kunit *test)
+{
+	struct gve_tx_dqo_test *t;
+	struct gve_tx_ring *tx;
+	int i;
+
+	t = kunit_kzalloc(test, sizeof(*t), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, t);
+	test->priv = t;
+
+	t->dev = alloc_etherdev(0);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, t->dev);
+	t->priv = kunit_kzalloc(test, sizeof(*t->priv), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, t->priv);
+	t->priv->dev = t->dev;
+
+	tx = kunit_kzalloc(test, sizeof(*tx), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, tx);
+	t->tx = tx;
+	u64_stats_init(&tx->statss);
+
+	/* A stopped queue keeps BQL from scheduling a qdisc the device was
+	 * never given.
+	 */
+	tx->netdev_txq = netdev_get_tx_queue(t->dev, 0);
+	netif_tx_stop_queue(tx->netdev_txq);
+
+	tx->mask = GVE_TEST_TX_RING_SIZE - 1;
+	tx->dqo.tx_ring = kunit_kcalloc(test, GVE_TEST_TX_RING_SIZE,
+					sizeof(tx->dqo.tx_ring[0]), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, tx->dqo.tx_ring);
+
+	tx->dqo.complq_mask = GVE_TEST_COMPLQ_SIZE - 1;
+	tx->dqo.compl_ring = kunit_kcalloc(test, GVE_TEST_COMPLQ_SIZE,
+					   sizeof(tx->dqo.compl_ring[0]),
+					   GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, tx->dqo.compl_ring);
+	t->compl_gen = 1;
+
+	/* As gve_tx_alloc_ring_dqo() sets up the lists. The fake QPL keeps
+	 * buffer release from trying to unmap anything.
+	 */
+	tx->dqo.num_pending_packets = GVE_TEST_PENDING_PACKETS;
+	tx->dqo.pending_packets =
+		kunit_kcalloc(test, GVE_TEST_PENDING_PACKETS,
+			      sizeof(tx->dqo.pending_packets[0]), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, tx->dqo.pending_packets);
+	for (i = 0; i < GVE_TEST_PENDING_PACKETS - 1; i++)
+		tx->dqo.pending_packets[i].next = i + 1;
+	tx->dqo.pending_packets[GVE_TEST_PENDING_PACKETS - 1].next = -1;
+	tx->dqo_tx.free_pending_packets = 0;
+	atomic_set_release(&tx->dqo_compl.free_pending_packets, -1);
+	tx->dqo_compl.miss_completions.head = -1;
+	tx->dqo_compl.miss_completions.tail = -1;
+	tx->dqo_compl.timed_out_completions.head = -1;
+	tx->dqo_compl.timed_out_completions.tail = -1;
+
+	tx->dqo.qpl = kunit_kzalloc(test, sizeof(*tx->dqo.qpl), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, tx->dqo.qpl);
+	tx->dqo.num_tx_bufs = GVE_TEST_TX_BUFS;
+	tx->dqo.tx_buf_next = kunit_kcalloc(test, GVE_TEST_TX_BUFS,
+					    sizeof(tx->dqo.tx_buf_next[0]),
+					    GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, tx->dqo.tx_buf_next);
+	for (i = 0; i < GVE_TEST_TX_BUFS - 1; i++)
+		tx->dqo.tx_buf_next[i] = i + 1;
+	tx->dqo.tx_buf_next[GVE_TEST_TX_BUFS - 1] = -1;
+	tx->dqo_tx.free_tx_buf_head = 0;
+	atomic_set_release(&tx->dqo_compl.free_tx_buf_head, -1);
+
+	return 0;
+}
+
+static void gve_tx_dqo_test_exit(struct kunit *test)
+{
+	struct gve_tx_dqo_test *t = test->priv;
+	int i;
+
+	if (!t)
+		return;
+
+	if (t->tx && t->tx->dqo.pending_packets) {
+		for (i = 0; i < GVE_TEST_PENDING_PACKETS; i++)
+			kfree_skb(t->tx->dqo.pending_packets[i].skb);
+	}
+	if (t->dev)
+		free_netdev(t->dev);
+}
+
+/* Queues a packet the way gve_tx_add_skb_dqo() does, minus the descriptors,
+ * and returns its completion tag.
+ */
+static s16 gve_tx_dqo_test_xmit(struct kunit *test, int num_bufs)
+{
+	struct gve_tx_dqo_test *t = test->priv;
+	struct gve_tx_pending_packet_dqo *pkt;
+	struct gve_tx_ring *tx = t->tx;
+	s16 index, tail = -1;
+	int i;
+
+	pkt = gve_alloc_pending_packet(tx);
+	KUNIT_ASSERT_NOT_NULL(test, pkt);
+
+	pkt->skb = alloc_skb(GVE_TEST_PKT_LEN, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, pkt->skb);
+	skb_put(pkt->skb, GVE_TEST_PKT_LEN);
+
+	pkt->num_bufs = 0;
+	for (i = 0; i < num_bufs; i++) {
+		index = gve_alloc_tx_buf(tx);
+		KUNIT_ASSERT_GE(test, index, 0);
+		gve_tx_pkt_append_buf(tx, pkt, tail, index);
+		tail = index;
+	}
+
+	netdev_tx_sent_queue(tx->netdev_txq, pkt->skb->len);
+	return pkt - tx->dqo.pending_packets;
+}
+
+/* Writes the next completion descriptor as the device would. */
+static void gve_tx_dqo_test_compl(struct kunit *test, u8 type, u16 tag)
+{
+	struct gve_tx_dqo_test *t = test->priv;
+	struct gve_tx_compl_desc *desc = &t->tx->dqo.compl_ring[t->compl_tail];
+
+	memset(desc, 0, sizeof(*desc));
+	desc->type = type;
+	desc->completion_tag = cpu_to_le16(tag);
+	desc->generation = t->compl_gen;
+
+	t->compl_tail = (t->compl_tail + 1) & t->tx->dqo.complq_mask;
+	t->compl_gen ^= t->compl_tail == 0;
+}
+
+static int gve_tx_dqo_test_clean(struct kunit *test)
+{
+	struct gve_tx_dqo_test *t = test->priv;
+	int cleaned;
+
+	GVE_KUNIT_CYCLES(test,
+			 cleaned = gve_clean_tx_done_dqo(t->priv, t->tx, NULL));
+	return cleaned;
+}
+
+static u8 gve_tx_dqo_test_state(struct kunit *test, s16 tag)
+{
+	struct gve_tx_dqo_test *t = test->priv;
+
+	return t->tx->dqo.pending_packets[tag].state;
+}
+
+static void gve_tx_dqo_test_fill_pkt_desc(struct kunit *test)
+{
+	struct gve_tx_dqo_test *t = test->priv;
+	const u32 len = 2 * GVE_TX_MAX_BUF_SIZE_DQO + 100;
+	const u64 addr = 0x100000;
+	struct gve_tx_ring *tx = t->tx;
+	struct gve_tx_pkt_desc_dqo *desc;
+	u32 desc_idx = tx->mask - 1;
+	struct sk_buff *skb;
+	int i;
+
+	skb = alloc_skb(0, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, skb);
+	skb->ip_summed = CHECKSUM_PARTIAL;
+
+	/* A buffer larger than a descriptor can describe is split, and the
+	 * descriptors wrap around the end of the ring.
+	 */
+	GVE_KUNIT_CYCLES(test,
+			 gve_tx_fill_pkt_desc_dqo(tx, &desc_idx, skb, len, addr,
+						  3, true, false));
+	KUNIT_EXPECT_EQ(test, desc_idx, 1);
+
+	for (i = 0; i < 3; i++) {
+		desc = &tx->dqo.tx_ring[(tx->mask - 1 + i) & tx->mask].pkt;
+
+		KUNIT_EXPECT_EQ(test, (u8)desc->dtype, GVE_TX_PKT_DESC_DTYPE_DQO);
+		KUNIT_EXPECT_EQ(test, le16_to_cpu(desc->compl_tag), 3);
+		KUNIT_EXPECT_EQ(test, (u8)desc->checksum_offload_enable, 1);
+		KUNIT_EXPECT_EQ(test, le64_to_cpu(desc->buf_addr),
+				addr + i * GVE_TX_MAX_BUF_SIZE_DQO);
+		KUNIT_EXPECT_EQ(test, (u32)desc->buf_size,
+				i < 2 ? GVE_TX_MAX_BUF_SIZE_DQO : 100);
+		KUNIT_EXPECT_EQ(test, (u8)desc->end_of_packet, i == 2);
+	}
+
+	kfree_skb(skb);
+}
+
+static void gve_tx_dqo_test_fill_tso_ctx_desc(struct kunit *test)
+{
+	struct gve_tx_tso_context_desc_dqo desc;
+	struct gve_tx_metadata_dqo metadata;
+	struct sk_buff *skb;
+	int i;
+
+	skb = alloc_skb(0, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, skb);
+	skb->len = 66 + 9000;
+	skb_shinfo(skb)->gso_size = 1448;
+
+	for (i = 0; i < ARRAY_SIZE(metadata.bytes); i++)
+		metadata.bytes[i] = 0xa0 + i;
+
+	memset(&desc, 0xff, sizeof(desc));
+	GVE_KUNIT_CYCLES(test,
+			 gve_tx_fill_tso_ctx_desc(&desc, skb, &metadata, 66));
+
+	KUNIT_EXPECT_EQ(test, desc.header_len, 66);
+	KUNIT_EXPECT_EQ(test, (u32)desc.tso_total_len, 9000);
+	KUNIT_EXPECT_EQ(test, (u16)desc.mss, 1448);
+	KUNIT_EXPECT_EQ(test, (u8)desc.cmd_dtype.dtype,
+			GVE_TX_TSO_CTX_DESC_DTYPE_DQO);
+	KUNIT_EXPECT_EQ(test, (u8)desc.cmd_dtype.tso, 1);
+	KUNIT_EXPECT_EQ(test, desc.flex0, metadata.bytes[0]);
+	KUNIT_EXPECT_EQ(test, desc.flex5, metadata.bytes[5]);
+	KUNIT_EXPECT_EQ(test, desc.flex9, metadata.bytes[9]);
+	KUNIT_EXPECT_EQ(test, (u8)desc.flex10, metadata.bytes[10]);
+	KUNIT_EXPECT_EQ(test, desc.flex11, metadata.bytes[11]);
+
+	kfree_skb(skb);
+}
+
+static void gve_tx_dqo_test_gen_bit_wrap(struct kunit *test)
+{
+	struct gve_tx_dqo_test *t = test->priv;
+	struct gve_tx_ring *tx = t->tx;
+	u32 total = 0;
+	s16 tags[3];
+	int round, i;
+
+	/* Five rounds of three completions run the head past the end of the
+	 * eight entry ring once, flipping the generation the driver expects.
+	 */
+	for (round = 0; round < 5; round++) {
+		for (i = 0; i < ARRAY_SIZE(tags); i++)
+			tags[i] = gve_tx_dqo_test_xmit(test, 2);
+		for (i = 0; i < ARRAY_SIZE(tags); i++)
+			gve_tx_dqo_test_compl(test, GVE_COMPL_TYPE_DQO_PKT,
+					      tags[i]);
+
+		KUNIT_EXPECT_EQ(test, gve_tx_dqo_test_clean(test), 3);
+		total += 3;
+		KUNIT_EXPECT_EQ(test, tx->dqo_compl.head,
+				total & tx->dqo.complq_mask);
+		KUNIT_EXPECT_EQ(test, tx->dqo_compl.cur_gen_bit,
+				(total / GVE_TEST_COMPLQ_SIZE) & 1);
+		for (i = 0; i < ARRAY_SIZE(tags); i++)
+			KUNIT_EXPECT_EQ(test, gve_tx_dqo_test_state(test, tags[i]),
+					GVE_PACKET_STATE_UNALLOCATED);
+
+		/* Descriptors left from the previous pass are not new. */
+		KUNIT_EXPECT_EQ(test, gve_tx_dqo_test_clean(test), 0);
+	}
+
+	KUNIT_EXPECT_EQ(test, tx->pkt_done, total);
+	KUNIT_EXPECT_EQ(test, tx->bytes_done, total * GVE_TEST_PKT_LEN);
+	KUNIT_EXPECT_EQ(test, atomic_read(&tx->dqo_compl.free_tx_buf_cnt),
+			2 * total);
+}
+
+static void gve_tx_dqo_test_desc_compl(struct kunit *test)
+{
+	struct gve_tx_dqo_test *t = test->priv;
+
+	gve_tx_dqo_test_compl(test, GVE_COMPL_TYPE_DQO_DESC, 11);
+	KUNIT_EXPECT_EQ(test, gve_tx_dqo_test_clean(test), 1);
+	KUNIT_EXPECT_EQ(test, atomic_read(&t->tx->dqo_compl.hw_tx_head), 11);
+	KUNIT_EXPECT_EQ(test, t->tx->pkt_done, 0);
+}
+
+static void gve_tx_dqo_test_miss_reinject(struct kunit *test)
+{
+	struct gve_tx_dqo_test *t = test->priv;
+	struct gve_tx_ring *tx = t->tx;
+	s16 tag = gve_tx_dqo_test_xmit(test, 3);
+
+	gve_tx_dqo_test_compl(test, GVE_COMPL_TYPE_DQO_MISS, tag);
+	KUNIT_EXPECT_EQ(test, gve_tx_dqo_test_clean(test), 1);
+	KUNIT_EXPECT_EQ(test, gve_tx_dqo_test_state(test, tag),
+			GVE_PACKET_STATE_PENDING_REINJECT_COMPL);
+	KUNIT_EXPECT_EQ(test, tx->dqo_compl.miss_completions.head, tag);
+	KUNIT_EXPECT_EQ(test, tx->pkt_done, 0);
+
+	/* A data completion after a miss is ignored. */
+	gve_tx_dqo_test_compl(test, GVE_COMPL_TYPE_DQO_PKT, tag);
+	KUNIT_EXPECT_EQ(test, gve_tx_dqo_test_clean(test), 1);
+	KUNIT_EXPECT_EQ(test, gve_tx_dqo_test_state(test, tag),
+			GVE_PACKET_STATE_PENDING_REINJECT_COMPL);
+	KUNIT_EXPECT_EQ(test, tx->pkt_done, 0);
+
+	gve_tx_dqo_test_compl(test, GVE_COMPL_TYPE_DQO_REINJECTION, tag);
+	KUNIT_EXPECT_EQ(test, gve_tx_dqo_test_clean(test), 1);
+	KUNIT_EXPECT_EQ(test, gve_tx_dqo_test_state(test, tag),
+			GVE_PACKET_STATE_UNALLOCATED);
+	KUNIT_EXPECT_EQ(test, tx->dqo_compl.miss_completions.head, -1);
+	KUNIT_EXPECT_EQ(test, tx->pkt_done, 1);
+	KUNIT_EXPECT_EQ(test, tx->bytes_done, GVE_TEST_PKT_LEN);
+	KUNIT_EXPECT_EQ(test, atomic_read(&tx->dqo_compl.free_tx_buf_cnt), 3);
+}
+
+static void gve_tx_dqo_test_alt_miss(struct kunit *test)
+{
+	struct gve_tx_dqo_test *t = test->priv;
+	s16 tag = gve_tx_dqo_test_xmit(test, 1);
+
+	/* Packet completions can carry the miss in the tag instead. */
+	gve_tx_dqo_test_compl(test, GVE_COMPL_TYPE_DQO_PKT,
+			      tag | GVE_ALT_MISS_COMPL_BIT);
+	KUNIT_EXPECT_EQ(test, gve_tx_dqo_test_clean(test), 1);
+	KUNIT_EXPECT_EQ(test, gve_tx_dqo_test_state(test, tag),
+			GVE_PACKET_STATE_PENDING_REINJECT_COMPL);
+	KUNIT_EXPECT_EQ(test, t->tx->pkt_done, 0);
+}
+
+static void gve_tx_dqo_test_reinject_without_miss(struct kunit *test)
+{
+	struct gve_tx_dqo_test *t = test->priv;
+	s16 tag = gve_tx_dqo_test_xmit(test, 1);
+
+	gve_tx_dqo_test_compl(test, GVE_COMPL_TYPE_DQO_REINJECTION, tag);
+	KUNIT_EXPECT_EQ(test, gve_tx_dqo_test_clean(test), 1);
+	KUNIT_EXPECT_EQ(test, gve_tx_dqo_test_state(test, tag),
+			GVE_PACKET_STATE_PENDING_DATA_COMPL);
+	KUNIT_EXPECT_EQ(test, t->tx->pkt_done, 0);
+
+	gve_tx_dqo_test_compl(test, GVE_COMPL_TYPE_DQO_PKT, tag);
+	KUNIT_EXPECT_EQ(test, gve_tx_dqo_test_clean(test), 1);
+	KUNIT_EXPECT_EQ(test, gve_tx_dqo_test_state(test, tag),
+			GVE_PACKET_STATE_UNALLOCATED);
+	KUNIT_EXPECT_EQ(test, t->tx->pkt_done, 1);
+}
+
+static void gve_tx_dqo_test_miss_timeout(struct kunit *test)
+{
+	struct gve_tx_dqo_test *t = test->priv;
+	struct gve_tx_ring *tx = t->tx;
+	s16 tag = gve_tx_dqo_test_xmit(test, 2);
+
+	gve_tx_dqo_test_compl(test, GVE_COMPL_TYPE_DQO_MISS, tag);
+	KUNIT_EXPECT_EQ(test, gve_tx_dqo_test_clean(test), 1);
+
+	/* No re-injection in time: the skb is dropped and its buffers are
+	 * released, but the tag stays allocated.
+	 */
+	tx->dqo.pending_packets[tag].timeout_jiffies = jiffies - 1;
+	KUNIT_EXPECT_EQ(test, gve_tx_dqo_test_clean(test), 0);
+	KUNIT_EXPECT_EQ(test, gve_tx_dqo_test_state(test, tag),
+			GVE_PACKET_STATE_TIMED_OUT_COMPL);
+	KUNIT_EXPECT_NULL(test, tx->dqo.pending_packets[tag].skb);
+	KUNIT_EXPECT_EQ(test, tx->dropped_pkt, 1);
+	KUNIT_EXPECT_EQ(test, tx->dqo_compl.miss_completions.head, -1);
+	KUNIT_EXPECT_EQ(test, tx->dqo_compl.timed_out_completions.head, tag);
+	KUNIT_EXPECT_EQ(test, atomic_read(&tx->dqo_compl.free_tx_buf_cnt), 2);
+
+	/* A late re-injection frees the tag without completing the packet. */
+	gve_tx_dqo_test_compl(test, GVE_COMPL_TYPE_DQO_REINJECTION, tag);
+	KUNIT_EXPECT_EQ(test, gve_tx_dqo_test_clean(test), 1);
+	KUNIT_EXPECT_EQ(test, gve_tx_dqo_test_state(test, tag),
+			GVE_PACKET_STATE_UNALLOCATED);
+	KUNIT_EXPECT_EQ(test, tx->dqo_compl.timed_out_completions.head, -1);
+	KUNIT_EXPECT_EQ(test, tx->pkt_done, 0);
+}
+
+static void gve_tx_dqo_test_bad_tag(struct kunit *test)
+{
+	struct gve_tx_dqo_test *t = test->priv;
+	s16 tag = gve_tx_dqo_test_xmit(test, 1);
+
+	gve_tx_dqo_test_compl(test, GVE_COMPL_TYPE_DQO_PKT,
+			      GVE_TEST_PENDING_PACKETS);
+	KUNIT_EXPECT_EQ(test, gve_tx_dqo_test_clean(test), 1);
+	KUNIT_EXPECT_EQ(test, gve_tx_dqo_test_state(test, tag),
+			GVE_PACKET_STATE_PENDING_DATA_COMPL);
+	KUNIT_EXPECT_EQ(test, t->tx->pkt_done, 0);
+}
+
+static struct kunit_case gve_tx_dqo_test_cases[] = {
+	KUNIT_CASE(gve_tx_dqo_test_fill_pkt_desc),
+	KUNIT_CASE(gve_tx_dqo_test_fill_tso_ctx_desc),
+	KUNIT_CASE(gve_tx_dqo_test_gen_bit_wrap),
+	KUNIT_CASE(gve_tx_dqo_test_desc_compl),
+	KUNIT_CASE(gve_tx_dqo_test_miss_reinject),
+	KUNIT_CASE(gve_tx_dqo_test_alt_miss),
+	KUNIT_CASE(gve_tx_dqo_test_reinject_without_miss),
+	KUNIT_CASE(gve_tx_dqo_test_miss_timeout),
+	KUNIT_CASE(gve_tx_dqo_test_bad_tag),
+	{}
+};
+
+static struct kunit_suite gve_tx_dqo_test_suite = {
+	.name = "gve_tx_dqo",
+	.init = gve_tx_dqo_test_init,
+	.exit = gve_tx_dqo_test_exit,
+	.test_cases = gve_tx_dqo_test_cases,
+};
+
+kunit_test_suite(gve_tx_dqo_test_suite);
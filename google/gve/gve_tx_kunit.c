@@ -0,0 +1,113 @@
+// SPDX-License-Identifier: (GPL-2.0 OR MIT)
+/* Google virtual Ethernet (gve) driver
+ *
+ * Copyright (C) 2015-2024 Google, Inc.
+ */
+
+/* KUnit tests for the GQI TX descriptor writers. Included at the end of
+ * gve_tx.c so the static functions are in scope.
+ */
+
+#include "gve_kunit.h"
+
+#define GVE_TEST_ADDR	0x123456789abc0ULL
+
+static void gve_tx_test_pkt_desc_tso(struct kunit *test)
+{
+	union gve_tx_desc desc;
+
+	memset(&desc, 0xff, sizeof(desc));
+	GVE_KUNIT_CYCLES(test,
+			 gve_tx_fill_pkt_desc(&desc, 16, CHECKSUM_PARTIAL, true,
+					      34, 3, 66, GVE_TEST_ADDR, 9066));
+
+	KUNIT_EXPECT_EQ(test, desc.pkt.type_flags, GVE_TXD_TSO | GVE_TXF_L4CSUM);
+	/* Offsets are in units of 16-bit words */
+	KUNIT_EXPECT_EQ(test, desc.pkt.l4_csum_offset, 8);
+	KUNIT_EXPECT_EQ(test, desc.pkt.l4_hdr_offset, 17);
+	KUNIT_EXPECT_EQ(test, desc.pkt.desc_cnt, 3);
+	KUNIT_EXPECT_EQ(test, be16_to_cpu(desc.pkt.len), 9066);
+	KUNIT_EXPECT_EQ(test, be16_to_cpu(desc.pkt.seg_len), 66);
+	KUNIT_EXPECT_EQ(test, be64_to_cpu(desc.pkt.seg_addr), GVE_TEST_ADDR);
+}
+
+static void gve_tx_test_pkt_desc_csum(struct kunit *test)
+{
+	union gve_tx_desc desc;
+
+	memset(&desc, 0xff, sizeof(desc));
+	GVE_KUNIT_CYCLES(test,
+			 gve_tx_fill_pkt_desc(&desc, 6, CHECKSUM_PARTIAL, false,
+					      34, 1, 182, GVE_TEST_ADDR, 182));
+
+	KUNIT_EXPECT_EQ(test, desc.pkt.type_flags, GVE_TXD_STD | GVE_TXF_L4CSUM);
+	KUNIT_EXPECT_EQ(test, desc.pkt.l4_csum_offset, 3);
+	KUNIT_EXPECT_EQ(test, desc.pkt.l4_hdr_offset, 17);
+	KUNIT_EXPECT_EQ(test, desc.pkt.desc_cnt, 1);
+	KUNIT_EXPECT_EQ(test, be16_to_cpu(desc.pkt.len), 182);
+}
+
+static void gve_tx_test_pkt_desc_no_csum(struct kunit *test)
+{
+	union gve_tx_desc desc;
+
+	/* Offsets left over from an earlier packet must not leak through. */
+	memset(&desc, 0xff, sizeof(desc));
+	GVE_KUNIT_CYCLES(test,
+			 gve_tx_fill_pkt_desc(&desc, 6, CHECKSUM_NONE, false,
+					      34, 2, 60, GVE_TEST_ADDR, 60));
+
+	KUNIT_EXPECT_EQ(test, desc.pkt.type_flags, GVE_TXD_STD);
+	KUNIT_EXPECT_EQ(test, desc.pkt.l4_csum_offset, 0);
+	KUNIT_EXPECT_EQ(test, desc.pkt.l4_hdr_offset, 0);
+	KUNIT_EXPECT_EQ(test, desc.pkt.desc_cnt, 2);
+	KUNIT_EXPECT_EQ(test, be16_to_cpu(desc.pkt.seg_len), 60);
+}
+
+static void gve_tx_test_seg_desc_tso_v6(struct kunit *test)
+{
+	union gve_tx_desc desc;
+
+	memset(&desc, 0, sizeof(desc));
+	GVE_KUNIT_CYCLES(test,
+			 gve_tx_fill_seg_desc(&desc, 14, 1428, true, true,
+					      4096, GVE_TEST_ADDR));
+
+	KUNIT_EXPECT_EQ(test, desc.seg.type_flags, GVE_TXD_SEG | GVE_TXSF_IPV6);
+	KUNIT_EXPECT_EQ(test, desc.seg.l3_offset, 7);
+	KUNIT_EXPECT_EQ(test, be16_to_cpu(desc.seg.mss), 1428);
+	KUNIT_EXPECT_EQ(test, be16_to_cpu(desc.seg.seg_len), 4096);
+	KUNIT_EXPECT_EQ(test, be64_to_cpu(desc.seg.seg_addr), GVE_TEST_ADDR);
+}
+
+static void gve_tx_test_seg_desc_plain(struct kunit *test)
+{
+	union gve_tx_desc desc;
+
+	memset(&desc, 0, sizeof(desc));
+	GVE_KUNIT_CYCLES(test,
+			 gve_tx_fill_seg_desc(&desc, 14, 1428, true, false,
+					      1000, GVE_TEST_ADDR));
+
+	/* Without TSO the IPv6 flag, L3 offset and MSS stay clear. */
+	KUNIT_EXPECT_EQ(test, desc.seg.type_flags, GVE_TXD_SEG);
+	KUNIT_EXPECT_EQ(test, desc.seg.l3_offset, 0);
+	KUNIT_EXPECT_EQ(test, desc.seg.mss, 0);
+	KUNIT_EXPECT_EQ(test, be16_to_cpu(desc.seg.seg_len), 1000);
+}
+
+static struct kunit_case gve_tx_test_cases[] = {
+	KUNIT_CASE(gve_tx_test_pkt_desc_tso),
+	KUNIT_CASE(gve_tx_test_pkt_desc_csum),
+	KUNIT_CASE(gve_tx_test_pkt_desc_no_csum),
+	KUNIT_CASE(gve_tx_test_seg_desc_tso_v6),
+	KUNIT_CASE(gve_tx_test_seg_desc_plain),
+	{}
+};
+
+static struct kunit_suite gve_tx_test_suite = {
+	.name = "gve_tx",
+	.test_cases = gve_tx_test_cases,
+};
+
+kunit_test_suite(gve_tx_test_suite);
@@ -6,6 +6,7 @@
 
 #include "gve.h"
 #include "gve_adminq.h"
+#include "gve_trace.h"
 #include "gve_utils.h"
 
 void gve_tx_remove_from_block(struct gve_priv *priv, int queue_idx)
@@ -87,3 +88,69 @@ void gve_dec_pagecnt_bias(struct gve_rx_slot_page_info *page_info)
 		page_ref_add(page_info->page, INT_MAX - pagecount);
 	}
 }
+
+void gve_rx_update_stats(struct gve_rx_ring *rx,
+			 const struct gve_rx_cnts *cnts)
+{
+	int i;
+
+	u64_stats_update_begin(&rx->statss);
+	rx->rpackets += cnts->ok_pkt_cnt;
+	rx->rbytes += cnts->ok_pkt_bytes;
+	rx->rheader_bytes += cnts->header_bytes;
+	rx->rx_cont_packet_cnt += cnts->cont_pkt_cnt;
+	rx->rx_desc_err_dropped_pkt += cnts->desc_err_pkt_cnt;
+	rx->rx_hsplit_pkt += cnts->hsplit_pkt_cnt;
+	rx->rx_hsplit_hbo_pkt += cnts->hsplit_hbo_pkt_cnt;
+	rx->rx_hsplit_err_dropped_pkt += cnts->hsplit_err_pkt_cnt;
+	rx->rx_copybreak_pkt += cnts->copybreak_pkt_cnt;
+	rx->rx_copied_pkt += cnts->copied_pkt_cnt;
+	rx->rx_skb_alloc_fail += cnts->skb_alloc_fail_cnt;
+	rx->rx_frag_flip_cnt += cnts->frag_flip_cnt;
+	rx->rx_frag_copy_cnt += cnts->frag_copy_cnt;
+	rx->rx_frag_alloc_cnt += cnts->frag_alloc_cnt;
+	rx->rx_lro_merged_pkt += cnts->lro_merged_pkt_cnt;
+	rx->rx_lro_aggr_cnt += cnts->lro_aggr_cnt;
+	rx->rx_page_aligned_pkt += cnts->page_aligned_pkt_cnt;
+	rx->rx_rsc_pkt += cnts->rsc_pkt_cnt;
+	rx->rx_rsc_segs += cnts->rsc_seg_cnt;
+	rx->xdp_tx_errors += cnts->xdp_tx_errors;
+	rx->xdp_redirect_errors += cnts->xdp_redirect_errors;
+	rx->xdp_alloc_fails += cnts->xdp_alloc_fails;
+	for (i = 0; i < GVE_XDP_ACTIONS; i++)
+		rx->xdp_actions[i] += cnts->xdp_actions[i];
+	u64_stats_update_end(&rx->statss);
+}
+
+static enum skb_drop_reason gve_skb_drop_reason(enum gve_drop_reason reason)
+{
+	switch (reason) {
+	case GVE_DROP_RX_NOMEM:
+	case GVE_DROP_TX_LINEARIZE:
+		return SKB_DROP_REASON_NOMEM;
+	case GVE_DROP_TX_JUMBO:
+		return SKB_DROP_REASON_IPV6BADEXTHDR;
+	case GVE_DROP_TX_MAP_ERR:
+	case GVE_DROP_TX_COMPL_TIMEOUT:
+		return SKB_DROP_REASON_DEV_READY;
+	default:
+		return SKB_DROP_REASON_DEV_HDR;
+	}
+}
+
+void gve_drop_skb(struct sk_buff *skb, u32 queue,
+		  enum gve_drop_reason reason)
+{
+	if (!skb)
+		return;
+
+	trace_gve_drop(skb, queue, reason);
+	dev_kfree_skb_any_reason(skb, gve_skb_drop_reason(reason));
+}
+
+void gve_drop_frags(struct napi_struct *napi, u32 queue,
+		    enum gve_drop_reason reason)
+{
+	gve_drop_skb(napi->skb, queue, reason);
+	napi->skb = NULL;
+}
@@ -26,5 +26,17 @@ struct sk_buff *gve_rx_copy(struct net_device *dev, struct napi_struct *napi,
 /* Decrement pagecnt_bias. Set it back to INT_MAX if it reached zero. */
 void gve_dec_pagecnt_bias(struct gve_rx_slot_page_info *page_info);
 
+/* Commit the counters accumulated during a poll to the ring stats. */
+void gve_rx_update_stats(struct gve_rx_ring *rx,
+			 const struct gve_rx_cnts *cnts);
+
+/* Free an skb that is being dropped on queue, recording the reason. */
+void gve_drop_skb(struct sk_buff *skb, u32 queue,
+		  enum gve_drop_reason reason);
+
+/* Drop the skb being assembled with napi_get_frags(). */
+void gve_drop_frags(struct napi_struct *napi, u32 queue,
+		    enum gve_drop_reason reason);
+
 #endif /* _GVE_UTILS_H */
 
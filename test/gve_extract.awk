@@ -0,0 +1,81 @@
+# Google virtual Ethernet (gve) driver
+#
+# Copyright (C) 2015-2024 Google, Inc.
+#
+# Prints the definitions named in `names` (space separated) from the driver
+# sources given as input, so the harness compiles the driver's own code rather
+# than a copy of it. Handles functions (including a return type on the
+# preceding line), struct, union and enum definitions and single line
+# #defines, in the order they appear in the input. A line marker is emitted
+# before each definition so diagnostics point at the driver source.
+
+BEGIN {
+	n = split(names, list, " ")
+	for (i = 1; i <= n; i++)
+		want[list[i]] = 1
+}
+
+FNR == 1 {
+	prev = ""
+}
+
+function start(name, line, first) {
+	found[name]++
+	printf "# %d \"%s\"\n", line, FILENAME
+	if (first != "")
+		print first
+	print
+	copying = 1
+}
+
+copying {
+	print
+	if ($0 ~ /^}/) {
+		copying = 0
+		print ""
+	}
+	prev = $0
+	next
+}
+
+/^#define [A-Za-z_0-9]+[ \t]/ {
+	if ($2 in want) {
+		found[$2]++
+		printf "# %d \"%s\"\n", FNR, FILENAME
+		print
+		print ""
+	}
+}
+
+/^(struct|union|enum) [a-z_0-9]+ {$/ {
+	if ($2 in want)
+		start($2, FNR, "")
+}
+
+/^[a-z_0-9]+\(/ && prev ~ /^[a-z]/ && prev !~ /[;,)]$/ {
+	name = $0
+	sub(/\(.*/, "", name)
+	if (name in want)
+		start(name, FNR - 1, prev)
+}
+
+/^[a-z][^(]*[ *][a-z_0-9]+\(/ && $0 !~ /;$/ {
+	name = $0
+	sub(/\(.*/, "", name)
+	sub(/.*[ *]/, "", name)
+	if (name in want)
+		start(name, FNR, "")
+}
+
+!copying {
+	prev = $0
+}
+
+END {
+	for (i = 1; i <= n; i++) {
+		if (!(list[i] in found)) {
+			printf "gve_extract: %s not found\n", list[i] > "/dev/stderr"
+			exit 1
+		}
+	}
+}
@@ -0,0 +1,1675 @@
+// SPDX-License-Identifier: (GPL-2.0 OR MIT)
+/* Google virtual Ethernet (gve) driver
+ *
+ * Copyright (C) 2015-2024 Google, Inc.
+ */
+
+/* User-space harness for the driver's ring bookkeeping: the GQI TX FIFO, the
+ * DQO RX buf_state stack, rings and page recycling, the DQO TX pending packet
+ * and buffer free lists, gve_can_send_tso() and the DQO TX completion path,
+ * driven by a model of the device.
+ *
+ * The code under test is the driver's own, extracted at build time. Each test
+ * runs a random sequence of operations against a simple model of what the
+ * structure should hold and fails on the first mismatch, printing the seed
+ * that reproduces it. With -b, ns/op microbenchmarks of the hot paths follow.
+ */
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "gve_shim.h"
+#include "gve_types.h"
+
+/* Only the fields the extracted functions touch. */
+struct gve_rx_ring {
+	struct gve_priv *gve;
+	struct {
+		struct gve_rx_buf_state_dqo *buf_states;
+		u16 num_buf_states;
+		struct gve_index_stack free_buf_states;
+		struct gve_index_ring recycled_buf_states;
+		struct gve_index_ring used_buf_states;
+		struct gve_queue_page_list *qpl;
+	} dqo;
+};
+
+struct gve_tx_ring {
+	struct {
+		s16 free_pending_packets;
+		u32 head;
+		u32 tail;
+		u16 completed_packet_desc_cnt;
+		s16 free_tx_buf_head;
+		u32 alloc_tx_buf_cnt;
+		u32 free_tx_buf_cnt;
+	} dqo_tx;
+	struct {
+		u32 head;
+		u8 cur_gen_bit;
+		unsigned long last_processed;
+		bool kicked;
+		atomic_t free_pending_packets;
+		atomic_t hw_tx_head;
+		struct gve_index_list miss_completions;
+		struct gve_index_list timed_out_completions;
+		atomic_t free_tx_buf_head;
+		atomic_t free_tx_buf_cnt;
+	} dqo_compl;
+	u64 pkt_done;
+	u64 bytes_done;
+	u64 dropped_pkt;
+	struct {
+		union gve_tx_desc_dqo *tx_ring;
+		struct gve_tx_compl_desc *compl_ring;
+		struct gve_tx_pending_packet_dqo *pending_packets;
+		s16 num_pending_packets;
+		u32 complq_mask;
+		struct gve_queue_page_list *qpl;
+		struct gve_tx_dma_buf_dqo *tx_dma_bufs;
+		s16 *tx_buf_next;
+		u32 num_tx_bufs;
+	} dqo;
+	struct netdev_queue *netdev_txq;
+	struct device *dev;
+	u32 mask;
+	u32 q_num;
+	struct u64_stats_sync statss;
+};
+
+unsigned long gve_shim_warnings;
+unsigned long gve_shim_net_errors;
+unsigned long jiffies;
+static unsigned long pages_freed;
+
+void gve_free_pages(struct device *dev, struct page *page, dma_addr_t dma,
+		    enum dma_data_direction dir, unsigned int order)
+{
+	page->refcount--;
+	pages_freed++;
+}
+
+/* Provided by the DQO TX device model below. */
+void gve_drop_skb(struct sk_buff *skb, u32 queue,
+		  enum gve_drop_reason reason);
+
+/* Latency sampling stays off, gve_tx_lat_key is never enabled. */
+struct static_key_false gve_tx_lat_key;
+
+void gve_tx_lat_complete(const struct gve_priv *priv, struct gve_tx_ring *tx,
+			 u32 id)
+{
+}
+
+void gve_tx_lat_drop(struct gve_tx_ring *tx, u32 id)
+{
+}
+
+void gve_tx_lat_reinject(const struct gve_priv *priv, struct gve_tx_ring *tx,
+			 unsigned long delay_jiffies)
+{
+}
+
+#include "gve_funcs.h"
+
+static unsigned long long seed;
+static u64 rng;
+
+#define CHECK(cond) do {						\
+	if (!(cond)) {							\
+		fprintf(stderr, "%s:%d: %s failed (seed %llu)\n",	\
+			__FILE__, __LINE__, #cond, seed);		\
+		exit(1);						\
+	}								\
+} while (0)
+
+static u32 rnd(void)
+{
+	rng ^= rng >> 12;
+	rng ^= rng << 25;
+	rng ^= rng >> 27;
+	return (rng * 0x2545F4914F6CDD1DULL) >> 32;
+}
+
+/* Uniform in [lo, hi] */
+static u32 rnd_range(u32 lo, u32 hi)
+{
+	return lo + rnd() % (hi - lo + 1);
+}
+
+static void *xcalloc(size_t n, size_t size)
+{
+	void *p = calloc(n, size);
+
+	CHECK(p);
+	return p;
+}
+
+/* GQI TX FIFO
+ *
+ * Packets are copied in the way gve_tx_add_skb_copy() does it: the header is
+ * allocated first, padded so it does not wrap, then the payload. Every byte
+ * of the FIFO has an owner and no allocation may hand out a byte still owned
+ * by an earlier one. Frees happen in allocation order, as completions do.
+ */
+
+#define FIFO_SIZE	(16 * PAGE_SIZE)
+#define FIFO_MAX_PKTS	(FIFO_SIZE / L1_CACHE_BYTES)
+
+struct fifo_pkt {
+	struct gve_tx_iovec iov[4];
+	u32 bytes;
+};
+
+static void fifo_own(u8 *owned, const struct gve_tx_iovec *iov, bool own)
+{
+	u32 len = iov->iov_len + iov->iov_padding;
+	u32 i;
+
+	CHECK(iov->iov_offset + len <= FIFO_SIZE);
+	for (i = iov->iov_offset; i < iov->iov_offset + len; i++) {
+		CHECK(owned[i] != own);
+		owned[i] = own;
+	}
+}
+
+static void fifo_check(struct gve_tx_fifo *fifo, u32 used)
+{
+	CHECK(fifo->head < fifo->size);
+	CHECK(fifo->head % L1_CACHE_BYTES == 0);
+	CHECK(atomic_read(&fifo->available) + used == fifo->size);
+}
+
+static void test_fifo(unsigned long iters)
+{
+	struct fifo_pkt *pkts = xcalloc(FIFO_MAX_PKTS, sizeof(*pkts));
+	u8 *owned = xcalloc(FIFO_SIZE, 1);
+	struct gve_tx_fifo fifo = {
+		.size = FIFO_SIZE,
+		.available = { FIFO_SIZE },
+	};
+	u32 head = 0, tail = 0, used = 0;
+	unsigned long n;
+	int i;
+
+	for (n = 0; n < iters; n++) {
+		struct fifo_pkt *pkt;
+
+		if (tail != head && rnd() % 2) {
+			pkt = &pkts[head++ % FIFO_MAX_PKTS];
+			for (i = 0; i < ARRAY_SIZE(pkt->iov); i++)
+				fifo_own(owned, &pkt->iov[i], false);
+			gve_tx_free_fifo(&fifo, pkt->bytes);
+			used -= pkt->bytes;
+		} else {
+			u32 len = rnd() % 4 ? rnd_range(1, 1514) :
+					      rnd_range(1, 65535);
+			u32 hlen = rnd_range(1, min_t(u32, len, 256));
+			int pad, hdr_nfrags, payload_nfrags, required;
+			u32 old_head = fifo.head;
+
+			pad = gve_tx_fifo_pad_alloc_one_frag(&fifo, hlen);
+			required = L1_CACHE_ALIGN(hlen) - hlen + pad + len;
+			if (!gve_tx_fifo_can_alloc(&fifo, required))
+				continue;
+
+			pkt = &pkts[tail++ % FIFO_MAX_PKTS];
+			memset(pkt, 0, sizeof(*pkt));
+			hdr_nfrags = gve_tx_alloc_fifo(&fifo, hlen + pad,
+						       &pkt->iov[0]);
+			payload_nfrags = gve_tx_alloc_fifo(&fifo, len - hlen,
+							   &pkt->iov[hdr_nfrags]);
+
+			/* The header is never split across the wrap. */
+			CHECK(pkt->iov[0].iov_offset == old_head);
+			CHECK(hdr_nfrags == (pad ? 2 : 1));
+			CHECK(pkt->iov[hdr_nfrags - 1].iov_len == hlen);
+			CHECK(pkt->iov[hdr_nfrags - 1].iov_offset % L1_CACHE_BYTES == 0);
+			CHECK(payload_nfrags >= 0 && payload_nfrags <= 2);
+
+			for (i = 0; i < ARRAY_SIZE(pkt->iov); i++) {
+				fifo_own(owned, &pkt->iov[i], true);
+				pkt->bytes += pkt->iov[i].iov_len +
+					      pkt->iov[i].iov_padding;
+			}
+			/* gve_skb_fifo_bytes_required() leaves out the padding
+			 * after the payload, which the aligned FIFO always has
+			 * room for.
+			 */
+			CHECK(pkt->bytes == L1_CACHE_ALIGN(required));
+			used += pkt->bytes;
+		}
+		fifo_check(&fifo, used);
+	}
+
+	while (tail != head)
+		gve_tx_free_fifo(&fifo, pkts[head++ % FIFO_MAX_PKTS].bytes);
+	CHECK(atomic_read(&fifo.available) == fifo.size);
+	free(owned);
+	free(pkts);
+}
+
+/* DQO RX buf_state stack and rings
+ *
+ * Each buf_state is either on the free stack, on one of the two rings or
+ * allocated. The model tracks where each one is, and the order of both rings,
+ * and checks every pop against it.
+ */
+
+#define NUM_BUF_STATES	100
+
+enum { BS_FREE, BS_ALLOCATED, BS_RECYCLED, BS_USED };
+
+struct model_ring {
+	u16 ids[NUM_BUF_STATES];
+	u32 head;
+	u32 len;
+};
+
+static void rx_ring_init(struct gve_rx_ring *rx, struct gve_priv *priv,
+			 u16 num_buf_states)
+{
+	int i;
+
+	memset(rx, 0, sizeof(*rx));
+	rx->gve = priv;
+	rx->dqo.num_buf_states = num_buf_states;
+	rx->dqo.buf_states = xcalloc(num_buf_states,
+				     sizeof(rx->dqo.buf_states[0]));
+	rx->dqo.free_buf_states.ids = xcalloc(num_buf_states,
+					      sizeof(u16));
+	CHECK(!gve_alloc_index_ring(&rx->dqo.recycled_buf_states,
+				    num_buf_states));
+	CHECK(!gve_alloc_index_ring(&rx->dqo.used_buf_states,
+				    num_buf_states));
+
+	/* As gve_rx_init_ring_state_dqo() sets it up. */
+	for (i = 0; i < num_buf_states; i++)
+		rx->dqo.free_buf_states.ids[i] = num_buf_states - 1 - i;
+	rx->dqo.free_buf_states.top = num_buf_states;
+}
+
+static void rx_ring_free(struct gve_rx_ring *rx)
+{
+	free(rx->dqo.buf_states);
+	free(rx->dqo.free_buf_states.ids);
+	free(rx->dqo.recycled_buf_states.ids);
+	free(rx->dqo.used_buf_states.ids);
+}
+
+static void test_buf_states(unsigned long iters)
+{
+	struct model_ring model[2] = {};
+	u8 where[NUM_BUF_STATES] = {};
+	u16 held[NUM_BUF_STATES];
+	struct gve_priv priv = {};
+	struct gve_rx_ring rx;
+	u32 num_held = 0, num_free = NUM_BUF_STATES;
+	unsigned long n;
+	int i;
+
+	rx_ring_init(&rx, &priv, NUM_BUF_STATES);
+	CHECK(rx.dqo.recycled_buf_states.mask + 1 == 128);
+
+	for (n = 0; n < iters; n++) {
+		struct gve_rx_buf_state_dqo *bs;
+		u32 r = rnd() % 5, k = rnd() % 2;
+		struct gve_index_ring *ring = k ? &rx.dqo.used_buf_states :
+						  &rx.dqo.recycled_buf_states;
+		struct model_ring *m = &model[k];
+		u16 id;
+
+		switch (r) {
+		case 0:
+			bs = gve_alloc_buf_state(&rx);
+			CHECK(!bs == !num_free);
+			if (!bs)
+				break;
+			id = bs - rx.dqo.buf_states;
+			CHECK(where[id] == BS_FREE);
+			CHECK(gve_buf_state_is_allocated(&rx, bs));
+			where[id] = BS_ALLOCATED;
+			held[num_held++] = id;
+			num_free--;
+			break;
+		case 1:
+		case 2:
+			if (!num_held)
+				break;
+			i = rnd() % num_held;
+			id = held[i];
+			held[i] = held[--num_held];
+			bs = &rx.dqo.buf_states[id];
+			if (r == 1) {
+				gve_free_buf_state(&rx, bs);
+				where[id] = BS_FREE;
+				num_free++;
+			} else {
+				gve_enqueue_buf_state(&rx, ring, bs);
+				where[id] = k ? BS_USED : BS_RECYCLED;
+				m->ids[(m->head + m->len++) % NUM_BUF_STATES] = id;
+			}
+			CHECK(!gve_buf_state_is_allocated(&rx, bs));
+			break;
+		default:
+			bs = gve_dequeue_buf_state(&rx, ring);
+			CHECK(!bs == !m->len);
+			if (!bs)
+				break;
+			id = bs - rx.dqo.buf_states;
+			CHECK(id == m->ids[m->head]);
+			m->head = (m->head + 1) % NUM_BUF_STATES;
+			m->len--;
+			CHECK(gve_buf_state_is_allocated(&rx, bs));
+			where[id] = BS_ALLOCATED;
+			held[num_held++] = id;
+			break;
+		}
+
+		CHECK(rx.dqo.free_buf_states.top == num_free);
+		for (k = 0; k < 2; k++) {
+			ring = k ? &rx.dqo.used_buf_states :
+				   &rx.dqo.recycled_buf_states;
+			CHECK(gve_index_ring_len(ring) == model[k].len);
+			CHECK(gve_index_ring_empty(ring) == !model[k].len);
+		}
+		CHECK(num_free + num_held + model[0].len + model[1].len ==
+		      NUM_BUF_STATES);
+	}
+
+	rx_ring_free(&rx);
+}
+
+/* DQO RX page recycling
+ *
+ * Drives the buffer lifecycle of the RDA and QPL datapaths: buffers are
+ * posted as gve_rx_post_buffers_dqo() does, received into an skb frag as
+ * gve_rx_skb_add_buf() does, and the stack drops those frags in random order.
+ * A buffer handed to the device must never overlap a frag the stack still
+ * holds, and every page the driver gives up must be returned exactly once.
+ */
+
+struct rx_frag {
+	struct page *page;
+	u32 offset;
+};
+
+static bool rx_frag_overlaps(const struct rx_frag *frags, u32 num_frags,
+			     const struct gve_rx_buf_state_dqo *bs, u32 size)
+{
+	u32 i;
+
+	for (i = 0; i < num_frags; i++) {
+		if (frags[i].page == bs->page_info.page &&
+		    frags[i].offset < bs->page_info.page_offset + size &&
+		    bs->page_info.page_offset < frags[i].offset + size)
+			return true;
+	}
+	return false;
+}
+
+static struct gve_rx_buf_state_dqo *rx_post_one(struct gve_rx_ring *rx,
+						struct page *pages,
+						u32 *num_pages, u32 max_pages)
+{
+	struct gve_rx_buf_state_dqo *bs;
+
+	bs = gve_get_recycled_buf_state(rx);
+	if (bs)
+		return bs;
+
+	bs = gve_alloc_buf_state(rx);
+	if (!bs)
+		return NULL;
+
+	if (*num_pages == max_pages) {
+		gve_free_buf_state(rx, bs);
+		return NULL;
+	}
+
+	/* As gve_alloc_page_dqo() sets it up. */
+	bs->page_info.page = &pages[(*num_pages)++];
+	bs->page_info.page->refcount = 1;
+	bs->page_info.page_offset = 0;
+	bs->last_single_ref_offset = 0;
+	page_ref_add(bs->page_info.page, INT_MAX - 1);
+	bs->page_info.pagecnt_bias = INT_MAX;
+	return bs;
+}
+
+static void test_rx_recycle(unsigned long iters, int buf_size, bool qpl)
+{
+	const u32 max_pages = qpl ? NUM_BUF_STATES : iters + NUM_BUF_STATES;
+	struct gve_rx_buf_state_dqo *posted[NUM_BUF_STATES];
+	struct pci_dev pdev = {};
+	struct gve_priv priv = {
+		.pdev = &pdev,
+		.data_buffer_size_dqo = buf_size,
+	};
+	struct gve_rx_ring rx;
+	struct rx_frag *frags;
+	struct page *pages;
+	u32 num_posted = 0, num_frags = 0, num_pages = 0;
+	unsigned long n;
+	u32 i;
+
+	pages = xcalloc(max_pages, sizeof(*pages));
+	frags = xcalloc(iters, sizeof(*frags));
+	rx_ring_init(&rx, &priv, NUM_BUF_STATES);
+	if (qpl)
+		rx.dqo.qpl = (struct gve_queue_page_list *)&pdev;
+	pages_freed = 0;
+
+	for (n = 0; n < iters; n++) {
+		struct gve_rx_buf_state_dqo *bs;
+		u32 r = rnd() % 8;
+
+		if (r < 3) {
+			bs = rx_post_one(&rx, pages, &num_pages, max_pages);
+			if (!bs)
+				continue;
+			CHECK(num_posted < NUM_BUF_STATES);
+			CHECK(!rx_frag_overlaps(frags, num_frags, bs, buf_size));
+			CHECK(bs->page_info.page_offset + buf_size <= PAGE_SIZE);
+			posted[num_posted++] = bs;
+		} else if (r < 6 || !num_frags) {
+			if (!num_posted)
+				continue;
+			i = rnd() % num_posted;
+			bs = posted[i];
+			posted[i] = posted[--num_posted];
+			frags[num_frags].page = bs->page_info.page;
+			frags[num_frags++].offset = bs->page_info.page_offset;
+			gve_dec_pagecnt_bias(&bs->page_info);
+			gve_try_recycle_buf(&priv, &rx, bs);
+		} else {
+			i = rnd() % num_frags;
+			frags[i].page->refcount--;
+			CHECK(frags[i].page->refcount >= 0);
+			frags[i] = frags[--num_frags];
+		}
+	}
+
+	if (qpl)
+		CHECK(!pages_freed);
+
+	/* Once the stack lets go of every frag, pages the driver gave back
+	 * are free and the ones it still holds have no other users.
+	 */
+	while (num_frags)
+		frags[--num_frags].page->refcount--;
+	for (i = 0; i < NUM_BUF_STATES; i++) {
+		struct gve_rx_buf_state_dqo *bs = &rx.dqo.buf_states[i];
+
+		if (bs->page_info.page)
+			gve_free_page_dqo(&priv, bs, true);
+	}
+	for (i = 0; i < num_pages; i++)
+		CHECK(pages[i].refcount == 0);
+	CHECK(pages_freed == num_pages);
+
+	rx_ring_free(&rx);
+	free(frags);
+	free(pages);
+}
+
+/* DQO TX pending packets and TX buffers
+ *
+ * Packets are allocated on the transmit side and freed on the completion
+ * side, which hands its free lists back when the transmit side runs dry.
+ * Each packet takes a chain of TX buffers, and the model checks the lists
+ * never lose, duplicate or mis-chain an entry.
+ */
+
+#define NUM_PENDING_PACKETS	64
+#define NUM_TX_BUFS		256
+
+static void tx_ring_init(struct gve_tx_ring *tx)
+{
+	int i;
+
+	memset(tx, 0, sizeof(*tx));
+	tx->dqo.num_pending_packets = NUM_PENDING_PACKETS;
+	tx->dqo.pending_packets = xcalloc(NUM_PENDING_PACKETS,
+					  sizeof(tx->dqo.pending_packets[0]));
+	tx->dqo.num_tx_bufs = NUM_TX_BUFS;
+	tx->dqo.tx_buf_next = xcalloc(NUM_TX_BUFS, sizeof(s16));
+
+	/* As gve_tx_alloc_ring_dqo() and gve_tx_buf_init() set them up. */
+	for (i = 0; i < NUM_PENDING_PACKETS - 1; i++)
+		tx->dqo.pending_packets[i].next = i + 1;
+	tx->dqo.pending_packets[NUM_PENDING_PACKETS - 1].next = -1;
+	atomic_set_release(&tx->dqo_compl.free_pending_packets, -1);
+
+	for (i = 0; i < NUM_TX_BUFS - 1; i++)
+		tx->dqo.tx_buf_next[i] = i + 1;
+	tx->dqo.tx_buf_next[NUM_TX_BUFS - 1] = -1;
+	atomic_set_release(&tx->dqo_compl.free_tx_buf_head, -1);
+}
+
+static void tx_ring_free(struct gve_tx_ring *tx)
+{
+	free(tx->dqo.pending_packets);
+	free(tx->dqo.tx_buf_next);
+}
+
+static void test_tx_lists(unsigned long iters)
+{
+	s16 bufs[NUM_PENDING_PACKETS][GVE_TX_MAX_DATA_DESCS];
+	s16 buf_owner[NUM_TX_BUFS];
+	u16 held[NUM_PENDING_PACKETS];
+	u32 num_held = 0, free_bufs = NUM_TX_BUFS;
+	struct gve_tx_ring tx;
+	unsigned long n;
+	int i, j;
+
+	tx_ring_init(&tx);
+	memset(buf_owner, 0xff, sizeof(buf_owner));
+
+	for (n = 0; n < iters; n++) {
+		struct gve_tx_pending_packet_dqo *pkt;
+		u16 id;
+
+		if (num_held && rnd() % 2) {
+			i = rnd() % num_held;
+			id = held[i];
+			held[i] = held[--num_held];
+			pkt = &tx.dqo.pending_packets[id];
+
+			/* The chain holds exactly the buffers appended. */
+			for (j = 0; j < pkt->num_bufs; j++) {
+				s16 index = j ? tx.dqo.tx_buf_next[bufs[id][j - 1]] :
+						pkt->tx_buf_head;
+
+				CHECK(index == bufs[id][j]);
+				CHECK(buf_owner[index] == id);
+				buf_owner[index] = -1;
+			}
+			free_bufs += pkt->num_bufs;
+			gve_free_tx_bufs(&tx, pkt);
+			CHECK(pkt->num_bufs == 0);
+			gve_free_pending_packet(&tx, pkt);
+			CHECK(pkt->state == GVE_PACKET_STATE_UNALLOCATED);
+		} else {
+			int count = rnd_range(1, GVE_TX_MAX_DATA_DESCS);
+			bool has_pkt = gve_has_pending_packet(&tx);
+			bool has_bufs = gve_has_free_tx_bufs(&tx, count);
+
+			CHECK(has_pkt == (num_held < NUM_PENDING_PACKETS));
+			CHECK(has_bufs == (count <= free_bufs));
+			if (!has_pkt || !has_bufs)
+				continue;
+
+			pkt = gve_alloc_pending_packet(&tx);
+			CHECK(pkt);
+			CHECK(pkt->state == GVE_PACKET_STATE_PENDING_DATA_COMPL);
+			id = pkt - tx.dqo.pending_packets;
+			for (i = 0; i < num_held; i++)
+				CHECK(held[i] != id);
+			held[num_held++] = id;
+
+			pkt->num_bufs = 0;
+			for (j = 0; j < count; j++) {
+				s16 index = gve_alloc_tx_buf(&tx);
+
+				CHECK(index >= 0 && index < NUM_TX_BUFS);
+				CHECK(buf_owner[index] == -1);
+				buf_owner[index] = id;
+				gve_tx_pkt_append_buf(&tx, pkt,
+						      j ? bufs[id][j - 1] : -1,
+						      index);
+				bufs[id][j] = index;
+			}
+			CHECK(pkt->num_bufs == count);
+			free_bufs -= count;
+		}
+	}
+
+	/* Draining both lists yields every entry exactly once. */
+	while (num_held) {
+		struct gve_tx_pending_packet_dqo *pkt =
+			&tx.dqo.pending_packets[held[--num_held]];
+
+		gve_free_tx_bufs(&tx, pkt);
+		gve_free_pending_packet(&tx, pkt);
+	}
+	for (i = 0; i < NUM_PENDING_PACKETS; i++)
+		CHECK(gve_alloc_pending_packet(&tx));
+	CHECK(!gve_alloc_pending_packet(&tx));
+	for (i = 0; i < NUM_TX_BUFS; i++)
+		CHECK(gve_alloc_tx_buf(&tx) >= 0);
+	CHECK(gve_alloc_tx_buf(&tx) == -1);
+
+	tx_ring_free(&tx);
+}
+
+/* gve_can_send_tso()
+ *
+ * Checked against a direct count: split the payload into gso_size segments
+ * and count the buffers each one touches, plus one for its header.
+ */
+
+static bool tso_ref(const struct sk_buff *skb)
+{
+	const struct skb_shared_info *shinfo = skb_shinfo(skb);
+	const int header_len = skb_checksum_start_offset(skb) + tcp_hdrlen(skb);
+	u32 ends[MAX_SKB_FRAGS + 1];
+	u32 start, total = 0;
+	int num_bufs = 0;
+	int first, i;
+
+	if (skb_headlen(skb) > header_len) {
+		total = skb_headlen(skb) - header_len;
+		ends[num_bufs++] = total;
+	}
+	for (i = 0; i < shinfo->nr_frags; i++) {
+		total += skb_frag_size(&shinfo->frags[i]);
+		ends[num_bufs++] = total;
+	}
+
+	first = 0;
+	for (start = 0; start < total; start += shinfo->gso_size) {
+		u32 end = min_t(u32, start + shinfo->gso_size, total);
+
+		while (ends[first] <= start)
+			first++;
+		for (i = first; ends[i] < end; i++)
+			;
+		if (1 + i - first + 1 > GVE_TX_MAX_DATA_DESCS)
+			return false;
+	}
+	return true;
+}
+
+static void tso_random_skb(struct sk_buff *skb)
+{
+	static const u32 frag_max[] = { 16, 256, 1500, 4096, 16384 };
+	u32 max = frag_max[rnd() % ARRAY_SIZE(frag_max)];
+	int i;
+
+	memset(skb, 0, sizeof(*skb));
+	skb->csum_start_offset = rnd_range(14, 128);
+	skb->tcp_hdrlen = 20 + 4 * rnd_range(0, 10);
+	skb->len = skb->csum_start_offset + skb->tcp_hdrlen;
+	if (rnd() % 2)
+		skb->len += rnd_range(0, 2048);
+
+	skb->shinfo.gso_size = rnd() % 4 ? rnd_range(536, 9000) :
+					   rnd_range(64, 536);
+	skb->shinfo.nr_frags = rnd_range(0, MAX_SKB_FRAGS);
+	for (i = 0; i < skb->shinfo.nr_frags; i++) {
+		skb->shinfo.frags[i].len = rnd_range(1, max);
+		skb->data_len += skb->shinfo.frags[i].len;
+	}
+	skb->len += skb->data_len;
+}
+
+static void test_tso(unsigned long iters)
+{
+	unsigned long n, sendable = 0;
+	struct sk_buff skb;
+
+	for (n = 0; n < iters; n++) {
+		bool ok;
+
+		tso_random_skb(&skb);
+		ok = gve_can_send_tso(&skb);
+		CHECK(ok == tso_ref(&skb));
+		sendable += ok;
+	}
+
+	/* Both outcomes must have been exercised. */
+	CHECK(sendable && sendable < iters);
+}
+
+/* DQO TX device model
+ *
+ * A device that fetches the descriptors the driver posts and writes back
+ * completions the way the DQO completion queue does: a descriptor completion
+ * after each fetch, packet completions out of order and now and then a miss
+ * completion, followed by a re-injection completion that may come after the
+ * driver gave up on it, or never. It also writes the odd completion the
+ * driver must reject. Each batch gve_clean_tx_done_dqo() consumes is replayed
+ * on a reference state machine, and the counters, BQL, tag states and lists,
+ * freed buffers, DMA unmaps and skbs are checked against it.
+ */
+
+#define TXM_RING_SIZE	256
+#define TXM_COMPLQ_SIZE	512
+#define TXM_MAX_BUFS	6
+#define TXM_DMA_BASE	0x100000000ULL
+#define TXM_DMA_STRIDE	0x10000
+
+/* The device's view of a completion tag. */
+enum { TXM_IDLE, TXM_QUEUED, TXM_SENT, TXM_MISSED };
+
+struct txm_pkt {
+	struct sk_buff skb; /* first, the skb callbacks cast back to the packet */
+	bool skb_live;
+	u16 num_bufs;
+	s16 bufs[TXM_MAX_BUFS];
+
+	u8 dev_state;
+	unsigned long miss_jiffies;
+	unsigned long hold; /* jiffies before the re-injection goes out */
+
+	/* Where the driver should have the tag. */
+	u8 state;
+	unsigned long timeout;
+};
+
+struct txm_desc {
+	u64 addr;
+	u32 size;
+	s16 tag;
+	bool eop;
+	bool csum;
+};
+
+struct txm_compl {
+	u8 type;
+	u16 tag;
+};
+
+static struct {
+	struct gve_priv *priv;
+	struct gve_tx_ring *tx;
+	struct napi_struct *napi;
+	bool qpl;
+
+	struct txm_pkt pkts[NUM_PENDING_PACKETS];
+	struct txm_desc desc[TXM_RING_SIZE];
+	u32 posted;
+	u32 fetched;
+	u32 reported;
+	u16 owed[NUM_PENDING_PACKETS]; /* tags still owed a completion */
+	u32 num_owed;
+	struct txm_compl compl[TXM_COMPLQ_SIZE];
+	u32 compl_head;
+	u32 compl_tail;
+
+	struct {
+		bool live;
+		bool head;
+		u32 len;
+	} dma[NUM_TX_BUFS];
+	u64 unmapped;
+	u64 skbs_consumed;
+	u64 skbs_dropped;
+	u64 xmits;
+	u64 late_reinjections;
+
+	/* Reference state */
+	struct {
+		u64 pkt_done;
+		u64 bytes_done;
+		u64 dropped_pkt;
+		u64 bql_pkts;
+		u64 bql_bytes;
+		u64 bufs_freed;
+		u64 unmapped;
+		u64 skbs_consumed;
+		u64 skbs_dropped;
+		u64 net_errors;
+		u16 hw_tx_head;
+		s16 miss[NUM_PENDING_PACKETS];
+		u32 num_miss;
+		s16 timed_out[NUM_PENDING_PACKETS];
+		u32 num_timed_out;
+	} ref;
+} txm;
+
+static void txm_unmap(struct device *dev, dma_addr_t addr, size_t size,
+		      enum dma_data_direction dir, bool head)
+{
+	u64 index = (addr - TXM_DMA_BASE) / TXM_DMA_STRIDE;
+
+	CHECK(!txm.qpl);
+	CHECK(dev == txm.tx->dev && dir == DMA_TO_DEVICE);
+	CHECK(addr >= TXM_DMA_BASE && index < NUM_TX_BUFS);
+	CHECK((addr - TXM_DMA_BASE) % TXM_DMA_STRIDE == 0);
+	CHECK(txm.dma[index].live);
+	CHECK(txm.dma[index].len == size && txm.dma[index].head == head);
+	txm.dma[index].live = false;
+	txm.unmapped++;
+}
+
+void dma_unmap_single(struct device *dev, dma_addr_t addr, size_t size,
+		      enum dma_data_direction dir)
+{
+	txm_unmap(dev, addr, size, dir, true);
+}
+
+void dma_unmap_page(struct device *dev, dma_addr_t addr, size_t size,
+		    enum dma_data_direction dir)
+{
+	txm_unmap(dev, addr, size, dir, false);
+}
+
+static void txm_skb_release(struct sk_buff *skb)
+{
+	struct txm_pkt *p = (struct txm_pkt *)skb;
+
+	CHECK(p >= txm.pkts && p < txm.pkts + NUM_PENDING_PACKETS);
+	CHECK(p->skb_live);
+	p->skb_live = false;
+}
+
+void napi_consume_skb(struct sk_buff *skb, int budget)
+{
+	CHECK(budget == !!txm.napi);
+	txm_skb_release(skb);
+	txm.skbs_consumed++;
+}
+
+void gve_drop_skb(struct sk_buff *skb, u32 queue,
+		  enum gve_drop_reason reason)
+{
+	CHECK(queue == txm.tx->q_num);
+	CHECK(reason == GVE_DROP_TX_COMPL_TIMEOUT);
+	txm_skb_release(skb);
+	txm.skbs_dropped++;
+}
+
+static void txm_init(struct gve_priv *priv, struct gve_tx_ring *tx,
+		     struct netdev_queue *txq, bool qpl)
+{
+	memset(&txm, 0, sizeof(txm));
+	txm.priv = priv;
+	txm.tx = tx;
+	txm.qpl = qpl;
+	gve_shim_net_errors = 0;
+	/* Start close to the wrap, the timeouts must survive it. */
+	jiffies = -(unsigned long)rnd_range(0, 100000);
+
+	tx_ring_init(tx);
+	tx->mask = TXM_RING_SIZE - 1;
+	tx->dqo.tx_ring = xcalloc(TXM_RING_SIZE, sizeof(*tx->dqo.tx_ring));
+	tx->dqo.complq_mask = TXM_COMPLQ_SIZE - 1;
+	tx->dqo.compl_ring = xcalloc(TXM_COMPLQ_SIZE,
+				     sizeof(*tx->dqo.compl_ring));
+	tx->dqo_compl.miss_completions.head = -1;
+	tx->dqo_compl.miss_completions.tail = -1;
+	tx->dqo_compl.timed_out_completions.head = -1;
+	tx->dqo_compl.timed_out_completions.tail = -1;
+	tx->netdev_txq = txq;
+	tx->dev = &priv->pdev->dev;
+	tx->q_num = 3;
+	/* The bounce buffers are never touched, only the RDA/QPL split. */
+	if (qpl)
+		tx->dqo.qpl = (struct gve_queue_page_list *)&txm;
+	else
+		tx->dqo.tx_dma_bufs = xcalloc(NUM_TX_BUFS,
+					      sizeof(*tx->dqo.tx_dma_bufs));
+}
+
+static void txm_free(struct gve_tx_ring *tx)
+{
+	free(tx->dqo.tx_ring);
+	free(tx->dqo.compl_ring);
+	free(tx->dqo.tx_dma_bufs);
+	tx_ring_free(tx);
+}
+
+/* Posts a packet the way gve_tx_add_skb_dqo() does once
+ * gve_maybe_stop_tx_dqo() found room for it.
+ */
+static bool txm_xmit(void)
+{
+	struct gve_tx_ring *tx = txm.tx;
+	struct gve_tx_pending_packet_dqo *pkt;
+	u32 num_bufs = rnd_range(1, TXM_MAX_BUFS);
+	bool csum = rnd() % 2;
+	u32 len[TXM_MAX_BUFS];
+	u32 num_descs = 0;
+	struct txm_pkt *p;
+	u32 desc_idx, i;
+	s16 tag;
+
+	for (i = 0; i < num_bufs; i++) {
+		len[i] = rnd() % 8 ? rnd_range(1, 4096) :
+				     rnd_range(1, 3 * GVE_TX_MAX_BUF_SIZE_DQO);
+		num_descs += DIV_ROUND_UP(len[i], GVE_TX_MAX_BUF_SIZE_DQO);
+	}
+
+	if (!gve_has_avail_slots_tx_dqo(tx, num_descs, num_bufs)) {
+		tx->dqo_tx.head =
+			atomic_read_acquire(&tx->dqo_compl.hw_tx_head);
+		if (!gve_has_avail_slots_tx_dqo(tx, num_descs, num_bufs))
+			return false;
+	}
+	/* Never over a descriptor the device has not fetched yet. */
+	CHECK(txm.posted + num_descs - txm.fetched < TXM_RING_SIZE);
+
+	pkt = gve_alloc_pending_packet(tx);
+	CHECK(pkt);
+	tag = pkt - tx->dqo.pending_packets;
+	p = &txm.pkts[tag];
+	CHECK(p->state == GVE_PACKET_STATE_UNALLOCATED);
+	CHECK(p->dev_state == TXM_IDLE && !p->skb_live);
+
+	memset(&p->skb, 0, sizeof(p->skb));
+	p->skb.ip_summed = csum ? CHECKSUM_PARTIAL : 0;
+	for (i = 0; i < num_bufs; i++)
+		p->skb.len += len[i];
+	p->skb.data_len = p->skb.len - len[0];
+	p->skb_live = true;
+	pkt->skb = &p->skb;
+	pkt->num_bufs = 0;
+
+	desc_idx = tx->dqo_tx.tail;
+	CHECK(desc_idx == (txm.posted & tx->mask));
+	for (i = 0; i < num_bufs; i++) {
+		s16 index = gve_alloc_tx_buf(tx);
+		u64 addr = TXM_DMA_BASE + (u64)index * TXM_DMA_STRIDE;
+		bool eop = i == num_bufs - 1;
+		u32 off;
+
+		CHECK(index >= 0 && index < NUM_TX_BUFS);
+		if (!txm.qpl) {
+			CHECK(!txm.dma[index].live);
+			txm.dma[index].live = true;
+			txm.dma[index].head = !i;
+			txm.dma[index].len = len[i];
+			tx->dqo.tx_dma_bufs[index].dma = addr;
+			tx->dqo.tx_dma_bufs[index].len = len[i];
+		}
+		gve_tx_pkt_append_buf(tx, pkt, i ? p->bufs[i - 1] : -1, index);
+		p->bufs[i] = index;
+
+		for (off = 0; off < len[i]; off += GVE_TX_MAX_BUF_SIZE_DQO) {
+			struct txm_desc *want =
+				&txm.desc[txm.posted++ & tx->mask];
+
+			want->addr = addr + off;
+			want->size = min_t(u32, len[i] - off,
+					   GVE_TX_MAX_BUF_SIZE_DQO);
+			want->tag = tag;
+			want->eop = eop && off + want->size == len[i];
+			want->csum = csum;
+		}
+		gve_tx_fill_pkt_desc_dqo(tx, &desc_idx, &p->skb, len[i], addr,
+					 tag, eop, false);
+	}
+	CHECK(desc_idx == (txm.posted & tx->mask));
+	tx->dqo_tx.tail = desc_idx;
+
+	p->num_bufs = num_bufs;
+	p->dev_state = TXM_QUEUED;
+	p->state = GVE_PACKET_STATE_PENDING_DATA_COMPL;
+	txm.xmits++;
+	return true;
+}
+
+static bool txm_write_compl(u8 type, u16 tag)
+{
+	struct gve_tx_compl_desc *desc;
+	u32 index = txm.compl_tail & (TXM_COMPLQ_SIZE - 1);
+
+	if (txm.compl_tail - txm.compl_head == TXM_COMPLQ_SIZE)
+		return false;
+
+	desc = &txm.tx->dqo.compl_ring[index];
+	*desc = (struct gve_tx_compl_desc){
+		.id = txm.tx->q_num,
+		.type = type,
+		.completion_tag = cpu_to_le16(tag),
+		/* The ring starts zeroed, so the first pass writes 1. */
+		.generation = !((txm.compl_tail / TXM_COMPLQ_SIZE) & 1),
+	};
+	txm.compl[index].type = type;
+	txm.compl[index].tag = tag;
+	txm.compl_tail++;
+	return true;
+}
+
+static void txm_fetch(u32 budget)
+{
+	struct gve_tx_ring *tx = txm.tx;
+
+	while (budget-- && txm.fetched != txm.posted) {
+		u32 idx = txm.fetched & tx->mask;
+		const struct gve_tx_pkt_desc_dqo *desc = &tx->dqo.tx_ring[idx].pkt;
+		const struct txm_desc *want = &txm.desc[idx];
+
+		CHECK(desc->dtype == GVE_TX_PKT_DESC_DTYPE_DQO);
+		CHECK(le64_to_cpu(desc->buf_addr) == want->addr);
+		CHECK(desc->buf_size == want->size);
+		CHECK((s16)le16_to_cpu(desc->compl_tag) == want->tag);
+		CHECK(desc->end_of_packet == want->eop);
+		CHECK(desc->checksum_offload_enable == want->csum);
+		CHECK(!desc->report_event);
+		txm.fetched++;
+
+		if (want->eop) {
+			struct txm_pkt *p = &txm.pkts[want->tag];
+
+			CHECK(p->dev_state == TXM_QUEUED);
+			p->dev_state = TXM_SENT;
+			txm.owed[txm.num_owed++] = want->tag;
+		}
+	}
+
+	if (txm.reported != txm.fetched &&
+	    txm_write_compl(GVE_COMPL_TYPE_DQO_DESC, txm.fetched & tx->mask))
+		txm.reported = txm.fetched;
+}
+
+static void txm_settle(u32 i)
+{
+	txm.pkts[txm.owed[i]].dev_state = TXM_IDLE;
+	txm.owed[i] = txm.owed[--txm.num_owed];
+}
+
+/* Past half the deallocation timeout the driver may be about to free the
+ * tag, so a re-injection not sent by then is lost for good.
+ */
+static void txm_forget_late(void)
+{
+	const unsigned long late_limit =
+		msecs_to_jiffies(GVE_DEALLOCATE_COMPL_TIMEOUT * MSEC_PER_SEC) / 2;
+	u32 i;
+
+	for (i = 0; i < txm.num_owed;) {
+		struct txm_pkt *p = &txm.pkts[txm.owed[i]];
+
+		if (p->dev_state == TXM_MISSED &&
+		    jiffies - p->miss_jiffies > late_limit)
+			txm_settle(i);
+		else
+			i++;
+	}
+}
+
+static void txm_complete(u32 count)
+{
+	const unsigned long reinject_timeout =
+		msecs_to_jiffies(GVE_REINJECT_COMPL_TIMEOUT * MSEC_PER_SEC);
+	u32 i;
+
+	txm_forget_late();
+	while (count-- && txm.num_owed &&
+	       txm.compl_tail - txm.compl_head < TXM_COMPLQ_SIZE) {
+		u32 r = rnd() % 64;
+		struct txm_pkt *p;
+		u16 tag;
+
+		i = rnd() % txm.num_owed;
+		tag = txm.owed[i];
+		p = &txm.pkts[tag];
+
+		if (p->dev_state == TXM_SENT) {
+			if (r == 0) {
+				/* No miss completion came first. */
+				txm_write_compl(GVE_COMPL_TYPE_DQO_REINJECTION,
+						tag);
+			} else if (r < 3) {
+				if (rnd() % 2)
+					txm_write_compl(GVE_COMPL_TYPE_DQO_MISS,
+							tag);
+				else
+					txm_write_compl(GVE_COMPL_TYPE_DQO_PKT,
+							tag | GVE_ALT_MISS_COMPL_BIT);
+				p->dev_state = TXM_MISSED;
+				p->miss_jiffies = jiffies;
+				p->hold = rnd_range(0, 2 * reinject_timeout);
+				if (rnd() % 4 == 0)
+					txm_settle(i);
+			} else {
+				txm_write_compl(GVE_COMPL_TYPE_DQO_PKT, tag);
+				txm_settle(i);
+			}
+		} else if (r < 4) {
+			/* A data completion after the miss completion. */
+			txm_write_compl(GVE_COMPL_TYPE_DQO_PKT, tag);
+		} else if (jiffies - p->miss_jiffies >= p->hold) {
+			txm_write_compl(GVE_COMPL_TYPE_DQO_REINJECTION, tag);
+			txm_settle(i);
+		}
+	}
+}
+
+static void txm_list_add(s16 *list, u32 *len, s16 tag)
+{
+	list[(*len)++] = tag;
+}
+
+static void txm_list_del(s16 *list, u32 *len, s16 tag)
+{
+	u32 i;
+
+	for (i = 0; list[i] != tag; i++)
+		CHECK(i + 1 < *len);
+	memmove(&list[i], &list[i + 1], (--*len - i) * sizeof(*list));
+}
+
+static void txm_list_check(const struct gve_index_list *list,
+			   const s16 *want, u32 len)
+{
+	s16 index = list->head;
+	s16 prev = -1;
+	u32 i;
+
+	for (i = 0; i < len; i++) {
+		CHECK(index == want[i]);
+		CHECK(txm.tx->dqo.pending_packets[index].prev == prev);
+		prev = index;
+		index = txm.tx->dqo.pending_packets[index].next;
+	}
+	CHECK(index == -1 && list->tail == prev);
+}
+
+static void txm_ref_release(struct txm_pkt *p, bool dropped)
+{
+	u32 i;
+
+	txm.ref.bufs_freed += p->num_bufs;
+	if (!txm.qpl) {
+		txm.ref.unmapped += p->num_bufs;
+		for (i = 0; i < p->num_bufs; i++)
+			CHECK(!txm.dma[p->bufs[i]].live);
+	}
+	if (dropped)
+		txm.ref.skbs_dropped++;
+	else
+		txm.ref.skbs_consumed++;
+	CHECK(!p->skb_live);
+}
+
+static void txm_ref_complete(struct txm_pkt *p, bool reinjection)
+{
+	txm.ref.pkt_done++;
+	txm.ref.bytes_done += p->skb.len;
+	if (!reinjection) {
+		txm.ref.bql_pkts++;
+		txm.ref.bql_bytes += p->skb.len;
+	}
+	txm_ref_release(p, false);
+	p->state = GVE_PACKET_STATE_UNALLOCATED;
+}
+
+static void txm_ref_miss(struct txm_pkt *p, u16 tag)
+{
+	if (p->state != GVE_PACKET_STATE_PENDING_DATA_COMPL) {
+		txm.ref.net_errors++;
+		return;
+	}
+	p->state = GVE_PACKET_STATE_PENDING_REINJECT_COMPL;
+	p->timeout = jiffies + msecs_to_jiffies(GVE_REINJECT_COMPL_TIMEOUT *
+						MSEC_PER_SEC);
+	txm.ref.bql_pkts++;
+	txm.ref.bql_bytes += p->skb.len;
+	txm_list_add(txm.ref.miss, &txm.ref.num_miss, tag);
+}
+
+/* Returns whether the completion counts against the NAPI budget. */
+static bool txm_ref_replay(const struct txm_compl *c)
+{
+	u16 tag = c->tag & ~GVE_ALT_MISS_COMPL_BIT;
+	struct txm_pkt *p = &txm.pkts[tag];
+
+	switch (c->type) {
+	case GVE_COMPL_TYPE_DQO_DESC:
+		txm.ref.hw_tx_head = c->tag;
+		break;
+	case GVE_COMPL_TYPE_DQO_PKT:
+		if (c->tag & GVE_ALT_MISS_COMPL_BIT) {
+			txm_ref_miss(p, tag);
+		} else if (p->state == GVE_PACKET_STATE_PENDING_DATA_COMPL) {
+			txm_ref_complete(p, false);
+			return true;
+		} else {
+			txm.ref.net_errors++;
+		}
+		break;
+	case GVE_COMPL_TYPE_DQO_MISS:
+		txm_ref_miss(p, tag);
+		break;
+	case GVE_COMPL_TYPE_DQO_REINJECTION:
+		if (p->state == GVE_PACKET_STATE_TIMED_OUT_COMPL) {
+			txm.ref.net_errors++;
+			txm_list_del(txm.ref.timed_out, &txm.ref.num_timed_out,
+				     tag);
+			p->state = GVE_PACKET_STATE_UNALLOCATED;
+			txm.late_reinjections++;
+		} else if (p->state !=
+			   GVE_PACKET_STATE_PENDING_REINJECT_COMPL) {
+			txm.ref.net_errors++;
+		} else {
+			txm_list_del(txm.ref.miss, &txm.ref.num_miss, tag);
+			txm_ref_complete(p, true);
+		}
+		break;
+	}
+	return false;
+}
+
+static void txm_ref_timeouts(void)
+{
+	struct txm_pkt *p;
+
+	while (txm.ref.num_miss) {
+		p = &txm.pkts[txm.ref.miss[0]];
+		if (time_is_after_jiffies(p->timeout))
+			break;
+		txm_list_add(txm.ref.timed_out, &txm.ref.num_timed_out,
+			     txm.ref.miss[0]);
+		txm_list_del(txm.ref.miss, &txm.ref.num_miss, txm.ref.miss[0]);
+		txm_ref_release(p, true);
+		txm.ref.dropped_pkt++;
+		txm.ref.net_errors++;
+		p->state = GVE_PACKET_STATE_TIMED_OUT_COMPL;
+		p->timeout = jiffies +
+			msecs_to_jiffies(GVE_DEALLOCATE_COMPL_TIMEOUT *
+					 MSEC_PER_SEC);
+	}
+
+	while (txm.ref.num_timed_out) {
+		p = &txm.pkts[txm.ref.timed_out[0]];
+		if (time_is_after_jiffies(p->timeout))
+			break;
+		p->state = GVE_PACKET_STATE_UNALLOCATED;
+		txm_list_del(txm.ref.timed_out, &txm.ref.num_timed_out,
+			     txm.ref.timed_out[0]);
+	}
+}
+
+static void txm_clean(bool use_napi)
+{
+	struct gve_tx_ring *tx = txm.tx;
+	struct napi_struct napi = {
+		.weight = rnd_range(1, 64),
+	};
+	u32 avail = txm.compl_tail - txm.compl_head;
+	u32 budget_used = 0;
+	int cleaned, i;
+
+	txm.napi = use_napi ? &napi : NULL;
+	cleaned = gve_clean_tx_done_dqo(txm.priv, tx, txm.napi);
+
+	/* Everything written, unless the NAPI budget ran out first. */
+	CHECK(cleaned >= 0 && cleaned <= avail);
+	for (i = 0; i < cleaned; i++) {
+		u32 index = txm.compl_head++ & (TXM_COMPLQ_SIZE - 1);
+
+		budget_used += txm_ref_replay(&txm.compl[index]);
+	}
+	CHECK(cleaned == avail ||
+	      (use_napi && budget_used == napi.weight));
+	CHECK(!use_napi || budget_used <= napi.weight);
+	txm_ref_timeouts();
+
+	CHECK(tx->dqo_compl.head == (txm.compl_head & tx->dqo.complq_mask));
+	CHECK(tx->dqo_compl.last_processed == jiffies);
+	CHECK(tx->pkt_done == txm.ref.pkt_done);
+	CHECK(tx->bytes_done == txm.ref.bytes_done);
+	CHECK(tx->dropped_pkt == txm.ref.dropped_pkt);
+	CHECK(tx->netdev_txq->completed_pkts == txm.ref.bql_pkts);
+	CHECK(tx->netdev_txq->completed_bytes == txm.ref.bql_bytes);
+	CHECK(atomic_read(&tx->dqo_compl.hw_tx_head) == txm.ref.hw_tx_head);
+	CHECK(atomic_read(&tx->dqo_compl.free_tx_buf_cnt) ==
+	      (u32)txm.ref.bufs_freed);
+	CHECK(txm.unmapped == txm.ref.unmapped);
+	CHECK(txm.skbs_consumed == txm.ref.skbs_consumed);
+	CHECK(txm.skbs_dropped == txm.ref.skbs_dropped);
+	CHECK(gve_shim_net_errors == txm.ref.net_errors);
+
+	for (i = 0; i < NUM_PENDING_PACKETS; i++) {
+		const struct gve_tx_pending_packet_dqo *pkt =
+			&tx->dqo.pending_packets[i];
+		const struct txm_pkt *p = &txm.pkts[i];
+
+		CHECK(pkt->state == p->state);
+		if (p->state == GVE_PACKET_STATE_PENDING_REINJECT_COMPL ||
+		    p->state == GVE_PACKET_STATE_TIMED_OUT_COMPL)
+			CHECK(pkt->timeout_jiffies == p->timeout);
+		CHECK(p->skb_live ==
+		      (p->state == GVE_PACKET_STATE_PENDING_DATA_COMPL ||
+		       p->state == GVE_PACKET_STATE_PENDING_REINJECT_COMPL));
+	}
+	txm_list_check(&tx->dqo_compl.miss_completions, txm.ref.miss,
+		       txm.ref.num_miss);
+	txm_list_check(&tx->dqo_compl.timed_out_completions,
+		       txm.ref.timed_out, txm.ref.num_timed_out);
+}
+
+static void test_tx_device(unsigned long iters, bool qpl)
+{
+	const unsigned long dealloc_timeout =
+		msecs_to_jiffies(GVE_DEALLOCATE_COMPL_TIMEOUT * MSEC_PER_SEC);
+	struct pci_dev pdev = {};
+	struct net_device netdev = {};
+	struct gve_priv priv = {
+		.dev = &netdev,
+		.pdev = &pdev,
+	};
+	struct netdev_queue txq = {};
+	struct gve_tx_ring tx;
+	unsigned long n;
+	int i;
+
+	txm_init(&priv, &tx, &txq, qpl);
+
+	for (n = 0; n < iters; n++) {
+		jiffies += rnd_range(0, 20);
+		switch (rnd() % 4) {
+		case 0:
+			txm_xmit();
+			break;
+		case 1:
+			txm_fetch(rnd_range(1, 32));
+			break;
+		case 2:
+			txm_complete(rnd_range(1, 8));
+			break;
+		default:
+			txm_clean(rnd() % 2);
+			/* Now and then long enough for every lost tag to be
+			 * freed.
+			 */
+			if (txm.compl_head == txm.compl_tail &&
+			    rnd() % 256 == 0) {
+				jiffies += dealloc_timeout;
+				txm_forget_late();
+			}
+			break;
+		}
+	}
+
+	/* Let the device finish what it owes, then wait out the tags it
+	 * lost.
+	 */
+	while (txm.fetched != txm.posted || txm.reported != txm.fetched ||
+	       txm.num_owed || txm.compl_head != txm.compl_tail) {
+		jiffies += rnd_range(0, 20);
+		txm_fetch(TXM_RING_SIZE);
+		txm_complete(TXM_COMPLQ_SIZE);
+		txm_clean(rnd() % 2);
+	}
+	jiffies += msecs_to_jiffies(GVE_REINJECT_COMPL_TIMEOUT * MSEC_PER_SEC);
+	txm_clean(false);
+	jiffies += dealloc_timeout;
+	txm_clean(false);
+
+	CHECK(!txm.ref.num_miss && !txm.ref.num_timed_out);
+	CHECK(txm.skbs_consumed + txm.skbs_dropped == txm.xmits);
+	CHECK(tx.dqo_tx.alloc_tx_buf_cnt ==
+	      atomic_read(&tx.dqo_compl.free_tx_buf_cnt));
+	for (i = 0; i < NUM_TX_BUFS; i++)
+		CHECK(!txm.dma[i].live);
+	for (i = 0; i < NUM_PENDING_PACKETS; i++)
+		CHECK(gve_alloc_pending_packet(&tx));
+	CHECK(!gve_alloc_pending_packet(&tx));
+	for (i = 0; i < NUM_TX_BUFS; i++)
+		CHECK(gve_alloc_tx_buf(&tx) >= 0);
+	CHECK(gve_alloc_tx_buf(&tx) == -1);
+
+	/* Both ends of the miss path must have been exercised. */
+	CHECK(txm.ref.dropped_pkt && txm.late_reinjections);
+
+	txm_free(&tx);
+}
+
+/* Microbenchmarks */
+
+#define BENCH_OPS	10000000UL
+
+static volatile unsigned long sink;
+
+static u64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void bench_report(const char *name, u64 start)
+{
+	printf("%-24s %8.2f ns/op\n", name,
+	       (double)(now_ns() - start) / BENCH_OPS);
+}
+
+static void bench_fifo(void)
+{
+	struct gve_tx_fifo fifo = {
+		.size = FIFO_SIZE,
+		.available = { FIFO_SIZE },
+	};
+	struct gve_tx_iovec iov[4];
+	unsigned long n;
+	u64 start;
+
+	start = now_ns();
+	for (n = 0; n < BENCH_OPS; n++) {
+		int pad = gve_tx_fifo_pad_alloc_one_frag(&fifo, 66);
+		int nfrags;
+
+		nfrags = gve_tx_alloc_fifo(&fifo, 66 + pad, &iov[0]);
+		nfrags += gve_tx_alloc_fifo(&fifo, 1448, &iov[nfrags]);
+		sink += nfrags;
+		gve_tx_free_fifo(&fifo, FIFO_SIZE - atomic_read(&fifo.available));
+	}
+	bench_report("fifo alloc+free", start);
+}
+
+static void bench_rx(void)
+{
+	struct pci_dev pdev = {};
+	struct gve_priv priv = {
+		.pdev = &pdev,
+		.data_buffer_size_dqo = 2048,
+	};
+	struct gve_rx_buf_state_dqo *bs;
+	struct gve_rx_ring rx;
+	struct page page = {};
+	unsigned long n;
+	u64 start;
+
+	rx_ring_init(&rx, &priv, NUM_BUF_STATES);
+
+	start = now_ns();
+	for (n = 0; n < BENCH_OPS; n++) {
+		bs = gve_alloc_buf_state(&rx);
+		sink += bs->allocated;
+		gve_free_buf_state(&rx, bs);
+	}
+	bench_report("buf_state stack", start);
+
+	bs = gve_alloc_buf_state(&rx);
+	start = now_ns();
+	for (n = 0; n < BENCH_OPS; n++) {
+		gve_recycle_buf(&rx, bs);
+		bs = gve_dequeue_buf_state(&rx, &rx.dqo.recycled_buf_states);
+		sink += bs->allocated;
+	}
+	bench_report("buf_state ring", start);
+
+	/* A buffer received and released by the stack right away. */
+	bs->page_info.page = &page;
+	page.refcount = INT_MAX;
+	bs->page_info.pagecnt_bias = INT_MAX;
+	start = now_ns();
+	for (n = 0; n < BENCH_OPS; n++) {
+		gve_dec_pagecnt_bias(&bs->page_info);
+		gve_try_recycle_buf(&priv, &rx, bs);
+		page.refcount--;
+		bs = gve_get_recycled_buf_state(&rx);
+	}
+	sink += bs->page_info.page_offset;
+	bench_report("rx recycle", start);
+
+	rx_ring_free(&rx);
+}
+
+static void bench_tx(void)
+{
+	struct gve_tx_pending_packet_dqo *pkt;
+	struct gve_tx_ring tx;
+	unsigned long n;
+	u64 start;
+	s16 tail;
+	int i;
+
+	tx_ring_init(&tx);
+
+	start = now_ns();
+	for (n = 0; n < BENCH_OPS; n++) {
+		pkt = gve_alloc_pending_packet(&tx);
+		sink += pkt->state;
+		gve_free_pending_packet(&tx, pkt);
+	}
+	bench_report("pending packet", start);
+
+	pkt = gve_alloc_pending_packet(&tx);
+	pkt->num_bufs = 0;
+	start = now_ns();
+	for (n = 0; n < BENCH_OPS; n++) {
+		tail = -1;
+		for (i = 0; i < 4; i++) {
+			s16 index = gve_alloc_tx_buf(&tx);
+
+			gve_tx_pkt_append_buf(&tx, pkt, tail, index);
+			tail = index;
+		}
+		gve_free_tx_bufs(&tx, pkt);
+	}
+	bench_report("tx bufs (4 per packet)", start);
+
+	tx_ring_free(&tx);
+}
+
+static void bench_tso(void)
+{
+	struct sk_buff skb = {
+		.csum_start_offset = 34,
+		.tcp_hdrlen = 32,
+		.shinfo = {
+			.gso_size = 1448,
+			.nr_frags = MAX_SKB_FRAGS,
+		},
+	};
+	unsigned long n;
+	u64 start;
+	int i;
+
+	for (i = 0; i < MAX_SKB_FRAGS; i++) {
+		skb.shinfo.frags[i].len = 4096;
+		skb.data_len += 4096;
+	}
+	skb.len = 66 + skb.data_len;
+
+	start = now_ns();
+	for (n = 0; n < BENCH_OPS; n++) {
+		/* Keep the compiler from hoisting the call. */
+		__asm__ volatile("" : : "r"(&skb) : "memory");
+		sink += gve_can_send_tso(&skb);
+	}
+	bench_report("can_send_tso (17 frags)", start);
+}
+
+/* One single-buffer packet posted, completed and cleaned per op. */
+static void bench_tx_clean(void)
+{
+	struct pci_dev pdev = {};
+	struct net_device netdev = {};
+	struct gve_priv priv = {
+		.dev = &netdev,
+		.pdev = &pdev,
+	};
+	struct netdev_queue txq = {};
+	struct gve_tx_ring tx;
+	unsigned long n;
+	u64 start;
+
+	txm_init(&priv, &tx, &txq, true);
+
+	start = now_ns();
+	for (n = 0; n < BENCH_OPS; n++) {
+		struct gve_tx_pending_packet_dqo *pkt =
+			gve_alloc_pending_packet(&tx);
+		s16 tag = pkt - tx.dqo.pending_packets;
+		s16 index = gve_alloc_tx_buf(&tx);
+		struct txm_pkt *p = &txm.pkts[tag];
+		u32 desc_idx = tx.dqo_tx.tail;
+
+		p->skb.len = 1514;
+		p->skb_live = true;
+		pkt->skb = &p->skb;
+		pkt->num_bufs = 0;
+		gve_tx_pkt_append_buf(&tx, pkt, -1, index);
+		gve_tx_fill_pkt_desc_dqo(&tx, &desc_idx, &p->skb, 1514,
+					 TXM_DMA_BASE, tag, true, false);
+		tx.dqo_tx.tail = desc_idx;
+
+		txm_write_compl(GVE_COMPL_TYPE_DQO_PKT, tag);
+		txm.compl_head += gve_clean_tx_done_dqo(&priv, &tx, NULL);
+	}
+	sink += tx.pkt_done;
+	bench_report("tx xmit+clean", start);
+
+	txm_free(&tx);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-s seed] [-n iterations] [-b]\n", prog);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long iters = 200000;
+	bool bench = false;
+	int opt;
+
+	seed = time(NULL);
+	while ((opt = getopt(argc, argv, "s:n:b")) != -1) {
+		switch (opt) {
+		case 's':
+			seed = strtoull(optarg, NULL, 0);
+			break;
+		case 'n':
+			iters = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			bench = true;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc || !iters)
+		usage(argv[0]);
+
+	printf("seed %llu, %lu iterations\n", seed, iters);
+	rng = seed | 1;
+
+	test_fifo(iters);
+	printf("ok fifo\n");
+	test_buf_states(iters);
+	printf("ok buf_states\n");
+	test_rx_recycle(iters, 2048, false);
+	test_rx_recycle(iters, 4096, false);
+	test_rx_recycle(iters, 2048, true);
+	printf("ok rx_recycle\n");
+	test_tx_lists(iters);
+	printf("ok tx_lists\n");
+	test_tso(iters / 8 + 1);
+	printf("ok tso\n");
+	test_tx_device(iters, false);
+	test_tx_device(iters, true);
+	printf("ok tx_device\n");
+	CHECK(!gve_shim_warnings);
+
+	if (bench) {
+		bench_fifo();
+		bench_rx();
+		bench_tx();
+		bench_tso();
+		bench_tx_clean();
+	}
+
+	return 0;
+}
@@ -0,0 +1,293 @@
+/* SPDX-License-Identifier: (GPL-2.0 OR MIT)
+ * Google virtual Ethernet (gve) driver
+ *
+ * Copyright (C) 2015-2024 Google, Inc.
+ */
+
+#ifndef _GVE_SHIM_H
+#define _GVE_SHIM_H
+
+/* Just enough of the kernel API for the driver code the harness extracts to
+ * compile in user space. Only the parts those functions touch are modelled.
+ */
+
+#include <endian.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef u64 dma_addr_t;
+typedef u16 __le16;
+typedef u32 __le32;
+typedef u64 __le64;
+
+#define cpu_to_le16(x)	htole16(x)
+#define cpu_to_le64(x)	htole64(x)
+#define le16_to_cpu(x)	le16toh(x)
+#define le64_to_cpu(x)	le64toh(x)
+
+#define __packed	__attribute__((packed))
+
+#define likely(x)	__builtin_expect(!!(x), 1)
+#define unlikely(x)	__builtin_expect(!!(x), 0)
+
+#define ARRAY_SIZE(a)	(sizeof(a) / sizeof((a)[0]))
+#define BIT(nr)		(1UL << (nr))
+#define DIV_ROUND_UP(n, d) (((n) + (d) - 1) / (d))
+#define S16_MAX		INT16_MAX
+#define min_t(type, a, b) ((type)(a) < (type)(b) ? (type)(a) : (type)(b))
+
+#define PAGE_SHIFT	12
+#define PAGE_SIZE	(1UL << PAGE_SHIFT)
+
+#define L1_CACHE_BYTES	64
+#define ALIGN(x, a)	(((x) + (a) - 1) & ~((__typeof__(x))(a) - 1))
+#define L1_CACHE_ALIGN(x) ALIGN(x, L1_CACHE_BYTES)
+
+#define WRITE_ONCE(x, val) (*(volatile __typeof__(x) *)&(x) = (val))
+#define prefetch(x)	__builtin_prefetch(x)
+#define dma_rmb()	__atomic_thread_fence(__ATOMIC_ACQUIRE)
+
+/* Time only moves when the harness advances it. */
+#define HZ		1000
+#define MSEC_PER_SEC	1000L
+extern unsigned long jiffies;
+
+static inline unsigned long msecs_to_jiffies(unsigned int m)
+{
+	return m * HZ / MSEC_PER_SEC;
+}
+
+#define time_is_after_jiffies(a) ((long)(jiffies - (a)) < 0)
+
+/* A WARN() that fires is a test failure, the harness checks the count. */
+extern unsigned long gve_shim_warnings;
+
+#define WARN(cond, fmt, ...) ({						\
+	int __ret = !!(cond);						\
+	if (unlikely(__ret)) {						\
+		gve_shim_warnings++;					\
+		fprintf(stderr, "WARN: " fmt "\n", ##__VA_ARGS__);	\
+	}								\
+	__ret;								\
+})
+
+/* Counted rather than printed, tests check for the errors they expect. */
+extern unsigned long gve_shim_net_errors;
+
+#define net_err_ratelimited(fmt, ...) (gve_shim_net_errors++)
+
+struct static_key_false {
+	int enabled;
+};
+
+#define static_branch_unlikely(key) unlikely((key)->enabled)
+
+#define GFP_KERNEL	0
+#define kvcalloc(n, size, gfp) calloc(n, size)
+#define kvfree(p)	free(p)
+
+static inline u32 roundup_pow_of_two(u32 n)
+{
+	return n <= 1 ? 1 : 1U << (32 - __builtin_clz(n - 1));
+}
+
+typedef struct {
+	int counter;
+} atomic_t;
+
+static inline int atomic_read(const atomic_t *v)
+{
+	return __atomic_load_n(&v->counter, __ATOMIC_RELAXED);
+}
+
+static inline int atomic_read_acquire(const atomic_t *v)
+{
+	return __atomic_load_n(&v->counter, __ATOMIC_ACQUIRE);
+}
+
+static inline void atomic_set(atomic_t *v, int i)
+{
+	__atomic_store_n(&v->counter, i, __ATOMIC_RELAXED);
+}
+
+static inline void atomic_set_release(atomic_t *v, int i)
+{
+	__atomic_store_n(&v->counter, i, __ATOMIC_RELEASE);
+}
+
+static inline void atomic_add(int i, atomic_t *v)
+{
+	__atomic_fetch_add(&v->counter, i, __ATOMIC_RELAXED);
+}
+
+static inline void atomic_sub(int i, atomic_t *v)
+{
+	__atomic_fetch_sub(&v->counter, i, __ATOMIC_RELAXED);
+}
+
+static inline int atomic_xchg(atomic_t *v, int i)
+{
+	return __atomic_exchange_n(&v->counter, i, __ATOMIC_SEQ_CST);
+}
+
+static inline int atomic_cmpxchg(atomic_t *v, int old, int new)
+{
+	__atomic_compare_exchange_n(&v->counter, &old, new, false,
+				    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+	return old;
+}
+
+/* Pages only carry the reference count the recycling logic looks at. */
+struct page {
+	int refcount;
+};
+
+static inline int page_count(struct page *page)
+{
+	return page->refcount;
+}
+
+static inline void page_ref_add(struct page *page, int nr)
+{
+	page->refcount += nr;
+}
+
+static inline void page_ref_sub(struct page *page, int nr)
+{
+	page->refcount -= nr;
+}
+
+#define MAX_SKB_FRAGS	17
+
+typedef struct {
+	u32 len;
+} skb_frag_t;
+
+static inline unsigned int skb_frag_size(const skb_frag_t *frag)
+{
+	return frag->len;
+}
+
+struct skb_shared_info {
+	u8 nr_frags;
+	unsigned short gso_size;
+	skb_frag_t frags[MAX_SKB_FRAGS];
+};
+
+/* A TSO skb reduced to its geometry: where the checksum starts, the TCP
+ * header length and how the payload is split between head and frags.
+ */
+struct sk_buff {
+	unsigned int len;
+	unsigned int data_len;
+	u8 ip_summed;
+	int csum_start_offset;
+	unsigned int tcp_hdrlen;
+	struct skb_shared_info shinfo;
+};
+
+#define CHECKSUM_PARTIAL	3
+
+#define skb_shinfo(skb)	(&(skb)->shinfo)
+
+static inline unsigned int skb_headlen(const struct sk_buff *skb)
+{
+	return skb->len - skb->data_len;
+}
+
+static inline int skb_checksum_start_offset(const struct sk_buff *skb)
+{
+	return skb->csum_start_offset;
+}
+
+static inline unsigned int tcp_hdrlen(const struct sk_buff *skb)
+{
+	return skb->tcp_hdrlen;
+}
+
+struct gve_header_buf;
+struct gve_queue_page_list;
+
+struct device {
+	int unused;
+};
+
+struct pci_dev {
+	struct device dev;
+};
+
+enum dma_data_direction {
+	DMA_TO_DEVICE = 1,
+	DMA_FROM_DEVICE = 2,
+};
+
+#define DEFINE_DMA_UNMAP_ADDR(name)	dma_addr_t name
+#define DEFINE_DMA_UNMAP_LEN(name)	u32 name
+#define dma_unmap_addr(ptr, name)	((ptr)->name)
+#define dma_unmap_len(ptr, name)	((ptr)->name)
+
+struct net_device {
+	char name[16];
+};
+
+struct napi_struct {
+	int weight;
+};
+
+/* BQL reduced to the totals the driver reports as completed. */
+struct netdev_queue {
+	u64 completed_pkts;
+	u64 completed_bytes;
+};
+
+static inline void netdev_tx_completed_queue(struct netdev_queue *txq,
+					     unsigned int pkts,
+					     unsigned int bytes)
+{
+	txq->completed_pkts += pkts;
+	txq->completed_bytes += bytes;
+}
+
+struct u64_stats_sync {
+	int unused;
+};
+
+static inline void u64_stats_update_begin(struct u64_stats_sync *syncp)
+{
+}
+
+static inline void u64_stats_update_end(struct u64_stats_sync *syncp)
+{
+}
+
+#define trace_gve_tx_complete_dqo(tx, desc) do { } while (0)
+
+/* Provided by the harness, which tracks the pages, mappings and skbs the
+ * driver gives back.
+ */
+void gve_free_pages(struct device *dev, struct page *page, dma_addr_t dma,
+		    enum dma_data_direction, unsigned int order);
+void dma_unmap_single(struct device *dev, dma_addr_t addr, size_t size,
+		      enum dma_data_direction dir);
+void dma_unmap_page(struct device *dev, dma_addr_t addr, size_t size,
+		    enum dma_data_direction dir);
+void napi_consume_skb(struct sk_buff *skb, int budget);
+
+struct gve_priv {
+	struct net_device *dev;
+	struct pci_dev *pdev;
+	int data_buffer_size_dqo;
+};
+
+#endif /* _GVE_SHIM_H */